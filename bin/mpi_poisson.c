@@ -0,0 +1,186 @@
+/*----------------------------------------------------------------------------*
+ * 1-D Poisson problem split across MPI ranks
+ *
+ * mpirun -np <ranks> mpi_poisson <elements per rank> <systems>
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <tricycl_mpi.h>
+
+//#define SINGLE_PRECISION
+
+#if defined(SINGLE_PRECISION)
+	typedef float real_t;
+#else
+	typedef double real_t;
+#endif
+
+#define SQR(x) (x)*(x)
+#define ABS(x, y) (x)-(y) > 0 ? (x)-(y) : (y)-(x)
+#define MAX(x, y) (x) > (y) ? (x) : (y)
+
+int main(int argc, char ** argv) {
+	int32_t ierr;
+	int rank, ranks;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+	if(argc != 3) {
+		if(rank == 0) {
+			fprintf(stderr, "Usage: %s <elements per rank> <systems>\n",
+				argv[0]);
+		} // if
+
+		MPI_Finalize();
+		exit(1);
+	} // if
+
+	size_t elements = atoi(argv[1]);
+	int32_t systems = atoi(argv[2]);
+	size_t global_elements = elements*ranks;
+
+	/*-------------------------------------------------------------------------*
+	 * Initialize OpenCL
+	 *-------------------------------------------------------------------------*/
+
+	cl_device_id device_id;
+	cl_context context;
+	cl_command_queue queue;
+	cl_platform_id platform;
+
+	ierr = clGetPlatformIDs(1, &platform, NULL);
+
+	if(ierr != CL_SUCCESS) {
+		fprintf(stderr, "clGetPlatformIDs failed with %d\n", ierr);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	} // if
+
+	int32_t cpu = 1;
+	ierr = clGetDeviceIDs(platform, cpu == 1 ? CL_DEVICE_TYPE_CPU :
+		CL_DEVICE_TYPE_GPU, 1, &device_id, NULL);
+
+	if(ierr != CL_SUCCESS) {
+		fprintf(stderr, "clGetDeviceIDs failed with %d\n", ierr);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	} // if
+
+	context = clCreateContext(0, 1, &device_id, NULL, NULL, &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		fprintf(stderr, "clCreateContext failed with %d\n", ierr);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	} // if
+
+	queue = clCreateCommandQueue(context, device_id, 0, &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		fprintf(stderr, "clCreateCommandQueue failed with %d\n", ierr);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Initialize TriCyCL
+	 *-------------------------------------------------------------------------*/
+#if defined(SINGLE_PRECISION)
+	size_t token = tricycl_init_sp(device_id, context, queue);
+#else
+	size_t token = tricycl_init_dp(device_id, context, queue);
+#endif
+
+	/*-------------------------------------------------------------------------*
+	 * Create this rank's rows of the system
+	 *-------------------------------------------------------------------------*/
+
+	real_t * sub = (real_t *)malloc(systems*elements*sizeof(real_t));
+	real_t * diag = (real_t *)malloc(systems*elements*sizeof(real_t));
+	real_t * sup = (real_t *)malloc(systems*elements*sizeof(real_t));
+	real_t * rhs = (real_t *)malloc(systems*elements*sizeof(real_t));
+	real_t * x = (real_t *)malloc(systems*elements*sizeof(real_t));
+	real_t x0 = 0.0;
+	real_t x1 = 1.0;
+	real_t h = (x1-x0)/(real_t)(global_elements-1);
+	real_t hinv2 = 1.0/SQR(h);
+
+	for(size_t s=0; s<systems; ++s) {
+		for(size_t i=0; i<elements; ++i) {
+			size_t global_i = rank*elements + i;
+
+			sub[s*elements + i] = hinv2*(-1.0);
+			diag[s*elements + i] = hinv2*(2.0);
+			sup[s*elements + i] = hinv2*(-1.0);
+
+			rhs[s*elements + i] =
+				(global_i==0 || global_i==(global_elements-1)) ? 1.0 : 0.0;
+
+			x[s*elements + i] = 0.0;
+		} // for
+
+		if(rank == 0) {
+			sub[s*elements] = 0.0;
+		} // if
+
+		if(rank == ranks-1) {
+			sup[s*elements + elements-1] = 0.0;
+		} // if
+	} // for
+
+	/*-------------------------------------------------------------------------*
+	 * Solve
+	 *-------------------------------------------------------------------------*/
+#if defined(SINGLE_PRECISION)
+	ierr = tricycl_solve_mpi_sp(token, MPI_COMM_WORLD, elements, systems,
+		sub, diag, sup, rhs, x);
+#else
+	ierr = tricycl_solve_mpi_dp(token, MPI_COMM_WORLD, elements, systems,
+		sub, diag, sup, rhs, x);
+#endif
+
+	if(ierr != TRICYCL_SUCCESS) {
+		fprintf(stderr, "rank %d: tricycl_solve_mpi failed with %d\n",
+			rank, ierr);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Error against the analytic solution (x = 1)
+	 *-------------------------------------------------------------------------*/
+
+	double rms = 0.0;
+	double max = 0.0;
+	for(size_t s=0; s<systems; ++s) {
+		for(size_t i=0; i<elements; ++i) {
+			const double abs = ABS(1.0, x[s*elements + i]);
+			rms += SQR(abs);
+			max = MAX(abs, max);
+		} // for
+	} // for
+
+	double global_rms = 0.0;
+	double global_max = 0.0;
+	MPI_Reduce(&rms, &global_rms, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&max, &global_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	if(rank == 0) {
+		global_rms /= (double)global_elements*systems;
+		global_rms = sqrt(global_rms);
+
+		fprintf(stdout, "ranks: %d\n", ranks);
+		fprintf(stdout, "rms: %e\n", global_rms);
+		fprintf(stdout, "max abs: %e\n", global_max);
+	} // if
+
+	free(sub);
+	free(diag);
+	free(sup);
+	free(rhs);
+	free(x);
+
+	MPI_Finalize();
+
+	return 0;
+} // main
@@ -90,6 +90,7 @@ int main(int argc, char ** argv) {
 	real_t * rhs = (real_t *)malloc(systems*elements*sizeof(real_t));
 	real_t * x = (real_t *)malloc(systems*elements*sizeof(real_t));
 	real_t * analytic = (real_t *)malloc(systems*elements*sizeof(real_t));
+	real_t * norms = (real_t *)malloc((2*systems+2)*sizeof(real_t));
 	real_t x0 = 0.0;
 	real_t x1 = 1.0;
 	real_t h = (x1-x0)/(real_t)(elements-1);
@@ -112,14 +113,21 @@ int main(int argc, char ** argv) {
 	} // for
 
 	/*-------------------------------------------------------------------------*
-	 * Solve
+	 * Solve, with the residual norms computed on the device
 	 *-------------------------------------------------------------------------*/
 #if defined(SINGLE_PRECISION)
-	ierr = tricycl_solve_sp(token, elements, systems, sub, diag, sup, rhs, x);
+	ierr = tricycl_solve_residual_sp(token, elements, systems, sub, diag, sup,
+		rhs, x, norms);
 #else
-	ierr = tricycl_solve_dp(token, elements, systems, sub, diag, sup, rhs, x);
+	ierr = tricycl_solve_residual_dp(token, elements, systems, sub, diag, sup,
+		rhs, x, norms);
 #endif
 
+	if(ierr != TRICYCL_SUCCESS) {
+		fprintf(stderr, "tricycl_solve_residual failed with %d\n", ierr);
+		exit(1);
+	} // if
+
 	double rms = 0.0;
 	double max = 0.0;
 	for(size_t s=0; s<systems; ++s) {
@@ -137,6 +145,8 @@ int main(int argc, char ** argv) {
 
 	fprintf(stdout, "rms: %e\n", rms);
 	fprintf(stdout, "max abs: %e\n", max);
+	fprintf(stdout, "residual l2: %e\n", norms[2*systems]);
+	fprintf(stdout, "residual max: %e\n", norms[2*systems+1]);
 
 	return 0;
 } // main
@@ -0,0 +1,453 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL benchmark
+ *
+ * Sweeps system size, number of systems, precision and device type and
+ * reports median solve latency, throughput and the speedup over a serial
+ * host Thomas solve as CSV (default) or JSON.
+ *----------------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tricycl.h>
+
+#define MAX_LIST 32
+#define MAX_DEVICES 4
+
+typedef struct {
+	size_t system_sizes[MAX_LIST];
+	size_t num_system_sizes;
+	size_t num_systems[MAX_LIST];
+	size_t num_num_systems;
+	int32_t precisions[2]; /* 0 sp, 1 dp */
+	size_t num_precisions;
+	cl_device_type devices[MAX_DEVICES];
+	size_t num_devices;
+	size_t warmup;
+	size_t reps;
+	int32_t json;
+} options_t;
+
+typedef struct {
+	const char * device;
+	const char * precision;
+	size_t system_size;
+	size_t num_systems;
+	double median;
+	double min;
+	double thomas;
+	double max_error;
+	int32_t error;
+} result_t;
+
+/*----------------------------------------------------------------------------*
+ * Timing.
+ *----------------------------------------------------------------------------*/
+
+static double wtime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1.0e-9*(double)ts.tv_nsec;
+} // wtime
+
+static int compare_double(const void * a, const void * b) {
+	const double da = *(const double *)a;
+	const double db = *(const double *)b;
+	return da < db ? -1 : (da > db ? 1 : 0);
+} // compare_double
+
+static double median(double * times, size_t n) {
+	qsort(times, n, sizeof(double), compare_double);
+	return n % 2 ? times[n/2] : 0.5*(times[n/2-1] + times[n/2]);
+} // median
+
+/*----------------------------------------------------------------------------*
+ * Per-precision helpers.
+ *
+ * Systems are random and diagonally dominant, generated with a fixed seed
+ * so that every run solves the same problems.
+ *----------------------------------------------------------------------------*/
+
+#define DEFINE_PRECISION(real_t, sfx)													\
+																									\
+static void generate_##sfx(size_t n, size_t m, real_t * a, real_t * b,			\
+	real_t * c, real_t * d) {																\
+	srand(1);																					\
+	for(size_t s=0; s<m; ++s) {															\
+		for(size_t i=0; i<n; ++i) {														\
+			const size_t k = s*n + i;														\
+			a[k] = i == 0 ? 0.0 : -(real_t)rand()/RAND_MAX;							\
+			c[k] = i == n-1 ? 0.0 : -(real_t)rand()/RAND_MAX;						\
+			b[k] = 2.0 + (real_t)rand()/RAND_MAX;										\
+			d[k] = (real_t)rand()/RAND_MAX;												\
+		} /* for */																				\
+	} /* for */																					\
+} /* generate */																				\
+																									\
+static void thomas_##sfx(size_t n, size_t m, const real_t * a,					\
+	const real_t * b, const real_t * c, const real_t * d, real_t * x,			\
+	real_t * w) {																				\
+	for(size_t s=0; s<m; ++s) {															\
+		const real_t * sa = a + s*n;														\
+		const real_t * sb = b + s*n;														\
+		const real_t * sc = c + s*n;														\
+		const real_t * sd = d + s*n;														\
+		real_t * sx = x + s*n;																\
+																									\
+		w[0] = sc[0]/sb[0];																\
+		sx[0] = sd[0]/sb[0];																\
+																									\
+		for(size_t i=1; i<n; ++i) {														\
+			const real_t r = 1.0/(sb[i] - sa[i]*w[i-1]);								\
+			w[i] = sc[i]*r;																	\
+			sx[i] = (sd[i] - sa[i]*sx[i-1])*r;											\
+		} /* for */																				\
+																									\
+		for(size_t i=n-1; i>0; --i) {														\
+			sx[i-1] -= w[i-1]*sx[i];														\
+		} /* for */																				\
+	} /* for */																					\
+} /* thomas */																					\
+																									\
+static double max_error_##sfx(size_t count, const real_t * x,					\
+	const real_t * reference) {															\
+	double max = 0.0;																			\
+	for(size_t i=0; i<count; ++i) {														\
+		const double e = fabs((double)x[i] - (double)reference[i]);				\
+		max = e > max ? e : max;															\
+	} /* for */																					\
+	return max;																					\
+} /* max_error */																				\
+																									\
+static void run_##sfx(size_t token, size_t n, size_t m,							\
+	const options_t * opts, result_t * result) {										\
+	const size_t count = n*m;																\
+	real_t * a = (real_t *)malloc(count*sizeof(real_t));							\
+	real_t * b = (real_t *)malloc(count*sizeof(real_t));							\
+	real_t * c = (real_t *)malloc(count*sizeof(real_t));							\
+	real_t * d = (real_t *)malloc(count*sizeof(real_t));							\
+	real_t * x = (real_t *)malloc(count*sizeof(real_t));							\
+	real_t * reference = (real_t *)malloc(count*sizeof(real_t));				\
+	real_t * w = (real_t *)malloc(n*sizeof(real_t));								\
+	double * times = (double *)malloc(opts->reps*sizeof(double));				\
+																									\
+	generate_##sfx(n, m, a, b, c, d);													\
+	result->error = 0;																		\
+																									\
+	for(size_t r=0; r<opts->warmup && result->error == 0; ++r) {				\
+		result->error = tricycl_solve_##sfx(token, n, m, a, b, c, d, x);		\
+	} /* for */																					\
+																									\
+	for(size_t r=0; r<opts->reps && result->error == 0; ++r) {					\
+		const double start = wtime();														\
+		result->error = tricycl_solve_##sfx(token, n, m, a, b, c, d, x);		\
+		times[r] = wtime() - start;														\
+	} /* for */																					\
+																									\
+	/* a failed solve is reported with its error code and no timings */		\
+	if(result->error == 0) {																\
+		result->median = median(times, opts->reps);									\
+		result->min = times[0];																\
+																									\
+		for(size_t r=0; r<opts->reps; ++r) {											\
+			const double start = wtime();													\
+			thomas_##sfx(n, m, a, b, c, d, reference, w);							\
+			times[r] = wtime() - start;													\
+		} /* for */																				\
+																									\
+		result->thomas = median(times, opts->reps);									\
+		result->max_error = max_error_##sfx(count, x, reference);				\
+	} /* if */																					\
+																									\
+	free(a); free(b); free(c); free(d); free(x);										\
+	free(reference); free(w); free(times);												\
+} /* run */
+
+DEFINE_PRECISION(float, sp)
+DEFINE_PRECISION(double, dp)
+
+/*----------------------------------------------------------------------------*
+ * Output.
+ *----------------------------------------------------------------------------*/
+
+static void print_result(const result_t * r, size_t precision_bytes,
+	int32_t json, int32_t first) {
+	// failed rows keep their place in the sweep, with empty timings
+	if(r->error != 0) {
+		if(json) {
+			fprintf(stdout, "%s  {\"device\": \"%s\", \"precision\": \"%s\", "
+				"\"system_size\": %lu, \"num_systems\": %lu, \"error\": %d}",
+				first ? "" : ",\n", r->device, r->precision,
+				(unsigned long)r->system_size, (unsigned long)r->num_systems,
+				r->error);
+		}
+		else {
+			fprintf(stdout, "%s,%s,%lu,%lu,,,,,,,,%d\n", r->device,
+				r->precision, (unsigned long)r->system_size,
+				(unsigned long)r->num_systems, r->error);
+		} // if
+
+		fflush(stdout);
+		return;
+	} // if
+
+	// a, b, c and d are uploaded and x is read back
+	const double bytes = 5.0*r->system_size*r->num_systems*precision_bytes;
+	const double systems_per_second = r->num_systems/r->median;
+	const double gbytes_per_second = 1.0e-9*bytes/r->median;
+	const double speedup = r->thomas/r->median;
+
+	if(json) {
+		fprintf(stdout, "%s  {\"device\": \"%s\", \"precision\": \"%s\", "
+			"\"system_size\": %lu, \"num_systems\": %lu, \"median_s\": %.9e, "
+			"\"min_s\": %.9e, \"systems_per_s\": %.6e, \"gbytes_per_s\": %.6e, "
+			"\"thomas_s\": %.9e, \"speedup\": %.6e, \"max_error\": %.6e, "
+			"\"error\": 0}", first ? "" : ",\n", r->device, r->precision,
+			(unsigned long)r->system_size, (unsigned long)r->num_systems,
+			r->median, r->min, systems_per_second, gbytes_per_second,
+			r->thomas, speedup, r->max_error);
+	}
+	else {
+		fprintf(stdout, "%s,%s,%lu,%lu,%.9e,%.9e,%.6e,%.6e,%.9e,%.6e,%.6e,0\n",
+			r->device, r->precision, (unsigned long)r->system_size,
+			(unsigned long)r->num_systems, r->median, r->min,
+			systems_per_second, gbytes_per_second, r->thomas, speedup,
+			r->max_error);
+	} // if
+
+	fflush(stdout);
+} // print_result
+
+/*----------------------------------------------------------------------------*
+ * Options.
+ *----------------------------------------------------------------------------*/
+
+static void usage(const char * name) {
+	fprintf(stderr, "Usage: %s [options]\n"
+		"  -n <sizes>     system sizes, e.g. 64,256,1024\n"
+		"  -m <counts>    numbers of systems, e.g. 1,16,256\n"
+		"  -p <list>      precisions: sp,dp\n"
+		"  -d <list>      device types: cpu,gpu,accelerator\n"
+		"  -w <count>     warm-up solves (default 2)\n"
+		"  -r <count>     timed solves (default 10)\n"
+		"  -f <format>    csv (default) or json\n", name);
+	exit(1);
+} // usage
+
+static size_t parse_sizes(char * arg, size_t * list) {
+	size_t count = 0;
+
+	for(char * tok = strtok(arg, ","); tok != NULL && count < MAX_LIST;
+		tok = strtok(NULL, ",")) {
+		list[count++] = (size_t)atol(tok);
+	} // for
+
+	return count;
+} // parse_sizes
+
+static void parse_options(int argc, char ** argv, options_t * opts) {
+	static const size_t default_sizes[] = { 64, 128, 256, 512, 1024 };
+	static const size_t default_counts[] = { 1, 16, 256 };
+	int opt;
+
+	memset(opts, 0, sizeof(options_t));
+
+	opts->num_system_sizes = sizeof(default_sizes)/sizeof(size_t);
+	memcpy(opts->system_sizes, default_sizes, sizeof(default_sizes));
+	opts->num_num_systems = sizeof(default_counts)/sizeof(size_t);
+	memcpy(opts->num_systems, default_counts, sizeof(default_counts));
+	opts->precisions[0] = 0;
+	opts->precisions[1] = 1;
+	opts->num_precisions = 2;
+	opts->devices[0] = CL_DEVICE_TYPE_CPU;
+	opts->num_devices = 1;
+	opts->warmup = 2;
+	opts->reps = 10;
+
+	while((opt = getopt(argc, argv, "n:m:p:d:w:r:f:h")) != -1) {
+		switch(opt) {
+			case 'n':
+				opts->num_system_sizes = parse_sizes(optarg, opts->system_sizes);
+				break;
+			case 'm':
+				opts->num_num_systems = parse_sizes(optarg, opts->num_systems);
+				break;
+			case 'p':
+				opts->num_precisions = 0;
+				for(char * tok = strtok(optarg, ","); tok != NULL &&
+					opts->num_precisions < 2; tok = strtok(NULL, ",")) {
+					if(strcmp(tok, "sp") == 0) {
+						opts->precisions[opts->num_precisions++] = 0;
+					}
+					else if(strcmp(tok, "dp") == 0) {
+						opts->precisions[opts->num_precisions++] = 1;
+					}
+					else {
+						usage(argv[0]);
+					} // if
+				} // for
+				break;
+			case 'd':
+				opts->num_devices = 0;
+				for(char * tok = strtok(optarg, ","); tok != NULL &&
+					opts->num_devices < MAX_DEVICES; tok = strtok(NULL, ",")) {
+					if(strcmp(tok, "cpu") == 0) {
+						opts->devices[opts->num_devices++] = CL_DEVICE_TYPE_CPU;
+					}
+					else if(strcmp(tok, "gpu") == 0) {
+						opts->devices[opts->num_devices++] = CL_DEVICE_TYPE_GPU;
+					}
+					else if(strcmp(tok, "accelerator") == 0) {
+						opts->devices[opts->num_devices++] =
+							CL_DEVICE_TYPE_ACCELERATOR;
+					}
+					else {
+						usage(argv[0]);
+					} // if
+				} // for
+				break;
+			case 'w':
+				opts->warmup = (size_t)atol(optarg);
+				break;
+			case 'r':
+				opts->reps = (size_t)atol(optarg);
+				break;
+			case 'f':
+				opts->json = strcmp(optarg, "json") == 0;
+				break;
+			default:
+				usage(argv[0]);
+		} // switch
+	} // while
+
+	if(opts->reps == 0) {
+		usage(argv[0]);
+	} // if
+} // parse_options
+
+/*----------------------------------------------------------------------------*
+ * Find the first device of a given type on any platform.
+ *----------------------------------------------------------------------------*/
+
+static int32_t find_device(cl_device_type type, cl_device_id * device_id) {
+	cl_platform_id platforms[8];
+	cl_uint num_platforms = 0;
+
+	if(clGetPlatformIDs(8, platforms, &num_platforms) != CL_SUCCESS) {
+		return 1;
+	} // if
+
+	for(cl_uint p=0; p<num_platforms && p<8; ++p) {
+		if(clGetDeviceIDs(platforms[p], type, 1, device_id, NULL) ==
+			CL_SUCCESS) {
+			return 0;
+		} // if
+	} // for
+
+	return 1;
+} // find_device
+
+static const char * device_name(cl_device_type type) {
+	return type == CL_DEVICE_TYPE_GPU ? "gpu" :
+		(type == CL_DEVICE_TYPE_ACCELERATOR ? "accelerator" : "cpu");
+} // device_name
+
+/*----------------------------------------------------------------------------*
+ * Main.
+ *----------------------------------------------------------------------------*/
+
+int main(int argc, char ** argv) {
+	options_t opts;
+	int32_t first = 1;
+	int32_t ierr;
+
+	parse_options(argc, argv, &opts);
+
+	if(opts.json) {
+		fprintf(stdout, "[\n");
+	}
+	else {
+		fprintf(stdout, "device,precision,system_size,num_systems,median_s,"
+			"min_s,systems_per_s,gbytes_per_s,thomas_s,speedup,max_error,"
+			"error\n");
+	} // if
+
+	for(size_t dv=0; dv<opts.num_devices; ++dv) {
+		cl_device_id device_id;
+
+		if(find_device(opts.devices[dv], &device_id) != 0) {
+			fprintf(stderr, "No %s device found, skipping\n",
+				device_name(opts.devices[dv]));
+			continue;
+		} // if
+
+		cl_context context = clCreateContext(0, 1, &device_id, NULL, NULL,
+			&ierr);
+
+		if(ierr != CL_SUCCESS) {
+			fprintf(stderr, "clCreateContext failed with %d\n", ierr);
+			exit(1);
+		} // if
+
+		cl_command_queue queue = clCreateCommandQueue(context, device_id, 0,
+			&ierr);
+
+		if(ierr != CL_SUCCESS) {
+			fprintf(stderr, "clCreateCommandQueue failed with %d\n", ierr);
+			exit(1);
+		} // if
+
+		for(size_t p=0; p<opts.num_precisions; ++p) {
+			const int32_t dp = opts.precisions[p];
+			const size_t token = dp ?
+				tricycl_init_dp(device_id, context, queue) :
+				tricycl_init_sp(device_id, context, queue);
+
+			for(size_t i=0; i<opts.num_system_sizes; ++i) {
+				for(size_t j=0; j<opts.num_num_systems; ++j) {
+					result_t result;
+					memset(&result, 0, sizeof(result_t));
+					result.device = device_name(opts.devices[dv]);
+					result.precision = dp ? "dp" : "sp";
+					result.system_size = opts.system_sizes[i];
+					result.num_systems = opts.num_systems[j];
+
+					if(dp) {
+						run_dp(token, result.system_size, result.num_systems,
+							&opts, &result);
+					}
+					else {
+						run_sp(token, result.system_size, result.num_systems,
+							&opts, &result);
+					} // if
+
+					if(result.error != 0) {
+						fprintf(stderr, "%s %s solve of %lu x %lu failed with %d\n",
+							result.device, result.precision,
+							(unsigned long)result.system_size,
+							(unsigned long)result.num_systems, result.error);
+					} // if
+
+					print_result(&result, dp ? sizeof(double) : sizeof(float),
+						opts.json, first);
+					first = 0;
+				} // for
+			} // for
+		} // for
+
+		clReleaseCommandQueue(queue);
+		clReleaseContext(context);
+	} // for
+
+	if(opts.json) {
+		fprintf(stdout, "\n]\n");
+	} // if
+
+	return 0;
+} // main
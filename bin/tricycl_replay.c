@@ -0,0 +1,426 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL replay of memory-mapped batches
+ *
+ * Solves the systems stored in a batch file and writes the solutions to a
+ * second file.  Both files are mapped and streamed through the solver in
+ * chunks of systems, so batches larger than memory can be replayed and
+ * timed.
+ *
+ * tricycl_replay [-c <systems per chunk>] [-d cpu|gpu|accelerator]
+ *    <input> <output>
+ *
+ * File format (native byte order):
+ *
+ *   offset  bytes  field
+ *        0      8  magic "TRICYCL\0"
+ *        8      4  version (1)
+ *       12      4  precision: bytes per value, 4 (float) or 8 (double)
+ *       16      4  arrays: 4 for a, b, c and d (input), 1 for x (output)
+ *       20      4  layout: 0 planar, 1 by system
+ *       24      8  system_size
+ *       32      8  num_systems
+ *       40     24  reserved (zero)
+ *       64         data
+ *
+ * Planar data stores all of a, then all of b, c and d, each as num_systems
+ * consecutive systems of system_size values (the tricycl_solve layout).
+ * By-system data stores a, b, c and d of the first system, then those of
+ * the second, and so on, which suits writers that dump one system at a
+ * time; it is copied into planar chunks before solving.  The output has
+ * the same header with arrays 1 and layout 0.
+ *
+ * While a chunk is solved the next input chunk is prefetched with
+ * posix_madvise, and each solved chunk is flushed with an asynchronous
+ * msync, so file I/O overlaps the solves.
+ *----------------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <tricycl.h>
+
+#define HEADER_MAGIC "TRICYCL"
+#define HEADER_VERSION 1
+#define LAYOUT_PLANAR 0
+#define LAYOUT_SYSTEM 1
+
+// default chunk, in bytes of input
+#define CHUNK_BYTES (64 << 20)
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t precision;
+	uint32_t arrays;
+	uint32_t layout;
+	uint64_t system_size;
+	uint64_t num_systems;
+	uint64_t reserved[3];
+} header_t;
+
+typedef int32_t (*solve_t)(size_t token, size_t system_size,
+	size_t num_systems, void * a, void * b, void * c, void * d, void * x);
+
+/*----------------------------------------------------------------------------*
+ * Timing.
+ *----------------------------------------------------------------------------*/
+
+static double wtime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + 1.0e-9*(double)ts.tv_nsec;
+} // wtime
+
+/*----------------------------------------------------------------------------*
+ * Per-precision solves.
+ *----------------------------------------------------------------------------*/
+
+static int32_t solve_sp(size_t token, size_t system_size, size_t num_systems,
+	void * a, void * b, void * c, void * d, void * x) {
+	return tricycl_solve_sp(token, system_size, num_systems, (float *)a,
+		(float *)b, (float *)c, (float *)d, (float *)x);
+} // solve_sp
+
+static int32_t solve_dp(size_t token, size_t system_size, size_t num_systems,
+	void * a, void * b, void * c, void * d, void * x) {
+	return tricycl_solve_dp(token, system_size, num_systems, (double *)a,
+		(double *)b, (double *)c, (double *)d, (double *)x);
+} // solve_dp
+
+/*----------------------------------------------------------------------------*
+ * Mapping helpers.  Ranges are file offsets, widened to whole pages.
+ *----------------------------------------------------------------------------*/
+
+static void page_range(size_t offset, size_t length, size_t * start,
+	size_t * pages) {
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	*start = offset - offset%page;
+	*pages = offset + length - *start;
+} // page_range
+
+static void advise(char * base, size_t offset, size_t length, int advice) {
+	size_t start, pages;
+	page_range(offset, length, &start, &pages);
+	posix_madvise(base + start, pages, advice);
+} // advise
+
+static void flush(char * base, size_t offset, size_t length) {
+	size_t start, pages;
+	page_range(offset, length, &start, &pages);
+	msync(base + start, pages, MS_ASYNC);
+} // flush
+
+/*----------------------------------------------------------------------------*
+ * Input chunk, as file offsets of its a, b, c and d.
+ *----------------------------------------------------------------------------*/
+
+static void chunk_offsets(const header_t * h, size_t first, size_t count,
+	size_t offsets[4], size_t * length) {
+	const size_t system_bytes = h->system_size*h->precision;
+
+	for(size_t k=0; k<4; ++k) {
+		offsets[k] = sizeof(header_t) + (h->layout == LAYOUT_PLANAR ?
+			(k*h->num_systems + first)*system_bytes : 4*first*system_bytes);
+	} // for
+
+	*length = h->layout == LAYOUT_PLANAR ? count*system_bytes :
+		4*count*system_bytes;
+} // chunk_offsets
+
+static void advise_chunk(const header_t * h, char * base, size_t first,
+	size_t count, int advice) {
+	size_t offsets[4], length;
+	chunk_offsets(h, first, count, offsets, &length);
+
+	for(size_t k=0; k<(h->layout == LAYOUT_PLANAR ? 4 : 1); ++k) {
+		advise(base, offsets[k], length, advice);
+	} // for
+} // advise_chunk
+
+/*----------------------------------------------------------------------------*
+ * Options.
+ *----------------------------------------------------------------------------*/
+
+static void usage(const char * name) {
+	fprintf(stderr, "Usage: %s [options] <input> <output>\n"
+		"  -c <count>     systems per chunk (default: 64 MB of input)\n"
+		"  -d <type>      device type: cpu (default), gpu or accelerator\n",
+		name);
+	exit(1);
+} // usage
+
+/*----------------------------------------------------------------------------*
+ * Find the first device of a given type on any platform.
+ *----------------------------------------------------------------------------*/
+
+static int32_t find_device(cl_device_type type, cl_device_id * device_id) {
+	cl_platform_id platforms[8];
+	cl_uint num_platforms = 0;
+
+	if(clGetPlatformIDs(8, platforms, &num_platforms) != CL_SUCCESS) {
+		return 1;
+	} // if
+
+	for(cl_uint p=0; p<num_platforms && p<8; ++p) {
+		if(clGetDeviceIDs(platforms[p], type, 1, device_id, NULL) ==
+			CL_SUCCESS) {
+			return 0;
+		} // if
+	} // for
+
+	return 1;
+} // find_device
+
+/*----------------------------------------------------------------------------*
+ * Main.
+ *----------------------------------------------------------------------------*/
+
+int main(int argc, char ** argv) {
+	cl_device_type type = CL_DEVICE_TYPE_CPU;
+	size_t chunk = 0;
+	int32_t ierr;
+	int opt;
+
+	while((opt = getopt(argc, argv, "c:d:h")) != -1) {
+		switch(opt) {
+			case 'c':
+				chunk = (size_t)atol(optarg);
+				break;
+			case 'd':
+				if(strcmp(optarg, "cpu") == 0) {
+					type = CL_DEVICE_TYPE_CPU;
+				}
+				else if(strcmp(optarg, "gpu") == 0) {
+					type = CL_DEVICE_TYPE_GPU;
+				}
+				else if(strcmp(optarg, "accelerator") == 0) {
+					type = CL_DEVICE_TYPE_ACCELERATOR;
+				}
+				else {
+					usage(argv[0]);
+				} // if
+				break;
+			default:
+				usage(argv[0]);
+		} // switch
+	} // while
+
+	if(argc - optind != 2) {
+		usage(argv[0]);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Map and check the input.
+	 *-------------------------------------------------------------------------*/
+
+	int in_fd = open(argv[optind], O_RDONLY);
+	struct stat st;
+
+	if(in_fd < 0 || fstat(in_fd, &st) != 0) {
+		fprintf(stderr, "Failed opening %s\n", argv[optind]);
+		exit(1);
+	} // if
+
+	if((size_t)st.st_size < sizeof(header_t)) {
+		fprintf(stderr, "%s: truncated header\n", argv[optind]);
+		exit(1);
+	} // if
+
+	char * in = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, in_fd,
+		0);
+
+	if(in == MAP_FAILED) {
+		fprintf(stderr, "Failed mapping %s\n", argv[optind]);
+		exit(1);
+	} // if
+
+	header_t h;
+	memcpy(&h, in, sizeof(header_t));
+
+	if(memcmp(h.magic, HEADER_MAGIC, sizeof(HEADER_MAGIC)) != 0 ||
+		h.version != HEADER_VERSION || h.arrays != 4 ||
+		(h.precision != sizeof(float) && h.precision != sizeof(double)) ||
+		(h.layout != LAYOUT_PLANAR && h.layout != LAYOUT_SYSTEM) ||
+		h.system_size == 0 || h.num_systems == 0) {
+		fprintf(stderr, "%s: not a TriCyCL input batch\n", argv[optind]);
+		exit(1);
+	} // if
+
+	const size_t n = h.system_size;
+	const size_t m = h.num_systems;
+	const size_t system_bytes = n*h.precision;
+
+	if((size_t)st.st_size < sizeof(header_t) + 4*m*system_bytes) {
+		fprintf(stderr, "%s: truncated data\n", argv[optind]);
+		exit(1);
+	} // if
+
+	if(chunk == 0) {
+		chunk = CHUNK_BYTES/(4*system_bytes);
+	} // if
+
+	chunk = chunk < 1 ? 1 : (chunk > m ? m : chunk);
+
+	/*-------------------------------------------------------------------------*
+	 * Create and map the output.
+	 *-------------------------------------------------------------------------*/
+
+	const size_t out_size = sizeof(header_t) + m*system_bytes;
+	int out_fd = open(argv[optind+1], O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if(out_fd < 0 || ftruncate(out_fd, out_size) != 0) {
+		fprintf(stderr, "Failed creating %s\n", argv[optind+1]);
+		exit(1);
+	} // if
+
+	char * out = (char *)mmap(NULL, out_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, out_fd, 0);
+
+	if(out == MAP_FAILED) {
+		fprintf(stderr, "Failed mapping %s\n", argv[optind+1]);
+		exit(1);
+	} // if
+
+	header_t out_h = h;
+	out_h.arrays = 1;
+	out_h.layout = LAYOUT_PLANAR;
+	memcpy(out, &out_h, sizeof(header_t));
+
+	// by-system input is copied into planar chunks
+	char * staging = NULL;
+
+	if(h.layout == LAYOUT_SYSTEM) {
+		staging = (char *)malloc(4*chunk*system_bytes);
+
+		if(staging == NULL) {
+			fprintf(stderr, "Failed allocating %lu chunk bytes\n",
+				(unsigned long)(4*chunk*system_bytes));
+			exit(1);
+		} // if
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Initialize OpenCL and TriCyCL.
+	 *-------------------------------------------------------------------------*/
+
+	cl_device_id device_id;
+
+	if(find_device(type, &device_id) != 0) {
+		fprintf(stderr, "No device of the requested type found\n");
+		exit(1);
+	} // if
+
+	cl_context context = clCreateContext(0, 1, &device_id, NULL, NULL, &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		fprintf(stderr, "clCreateContext failed with %d\n", ierr);
+		exit(1);
+	} // if
+
+	cl_command_queue queue = clCreateCommandQueue(context, device_id, 0,
+		&ierr);
+
+	if(ierr != CL_SUCCESS) {
+		fprintf(stderr, "clCreateCommandQueue failed with %d\n", ierr);
+		exit(1);
+	} // if
+
+	const int32_t dp = h.precision == sizeof(double);
+	const size_t token = dp ? tricycl_init_dp(device_id, context, queue) :
+		tricycl_init_sp(device_id, context, queue);
+	const solve_t solve = dp ? solve_dp : solve_sp;
+
+	/*-------------------------------------------------------------------------*
+	 * Stream the chunks.
+	 *-------------------------------------------------------------------------*/
+
+	const double start = wtime();
+	double solve_seconds = 0.0;
+
+	advise_chunk(&h, in, 0, chunk, POSIX_MADV_WILLNEED);
+
+	for(size_t first=0; first<m; first += chunk) {
+		const size_t count = first + chunk > m ? m - first : chunk;
+		size_t offsets[4], length;
+		char * arrays[4];
+
+		// read ahead while this chunk is solved
+		if(first + count < m) {
+			const size_t next = first + count;
+			advise_chunk(&h, in, next, next + chunk > m ? m - next : chunk,
+				POSIX_MADV_WILLNEED);
+		} // if
+
+		chunk_offsets(&h, first, count, offsets, &length);
+
+		if(h.layout == LAYOUT_PLANAR) {
+			for(size_t k=0; k<4; ++k) {
+				arrays[k] = in + offsets[k];
+			} // for
+		}
+		else {
+			for(size_t k=0; k<4; ++k) {
+				arrays[k] = staging + k*count*system_bytes;
+
+				for(size_t s=0; s<count; ++s) {
+					memcpy(arrays[k] + s*system_bytes,
+						in + offsets[0] + (4*s + k)*system_bytes, system_bytes);
+				} // for
+			} // for
+		} // if
+
+		const size_t x_offset = sizeof(header_t) + first*system_bytes;
+		const double solve_start = wtime();
+
+		ierr = solve(token, n, count, arrays[0], arrays[1], arrays[2],
+			arrays[3], out + x_offset);
+
+		solve_seconds += wtime() - solve_start;
+
+		if(ierr != TRICYCL_SUCCESS) {
+			fprintf(stderr, "tricycl_solve failed with %d on systems %lu-%lu\n",
+				ierr, (unsigned long)first, (unsigned long)(first + count-1));
+			exit(1);
+		} // if
+
+		// write back the solutions and drop the consumed input
+		flush(out, x_offset, count*system_bytes);
+		advise_chunk(&h, in, first, count, POSIX_MADV_DONTNEED);
+	} // for
+
+	if(msync(out, out_size, MS_SYNC) != 0) {
+		fprintf(stderr, "Failed writing %s\n", argv[optind+1]);
+		exit(1);
+	} // if
+
+	const double total = wtime() - start;
+	const double bytes = 5.0*m*system_bytes;
+
+	fprintf(stdout, "precision: %s\n", dp ? "dp" : "sp");
+	fprintf(stdout, "system_size: %lu\n", (unsigned long)n);
+	fprintf(stdout, "num_systems: %lu\n", (unsigned long)m);
+	fprintf(stdout, "chunk: %lu\n", (unsigned long)chunk);
+	fprintf(stdout, "solve (s): %e\n", solve_seconds);
+	fprintf(stdout, "total (s): %e\n", total);
+	fprintf(stdout, "GB/s: %e\n", 1.0e-9*bytes/total);
+
+	free(staging);
+	munmap(out, out_size);
+	munmap(in, st.st_size);
+	close(out_fd);
+	close(in_fd);
+
+	clReleaseCommandQueue(queue);
+	clReleaseContext(context);
+
+	return 0;
+} // main
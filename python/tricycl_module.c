@@ -0,0 +1,301 @@
+/*----------------------------------------------------------------------------*
+ * Python bindings.
+ *
+ * The arrays are taken through the buffer protocol (NumPy arrays,
+ * array.array, memoryview, ...) and passed to the library without a
+ * copy, so they must be C-contiguous and of the precision of the call.
+ * A 1-D array is one system; a 2-D array of shape
+ * (num_systems, system_size) is a batch.  The GIL is released while the
+ * library runs.
+ *
+ * OpenCL handles are passed as integers or as objects with an int_ptr
+ * attribute (pyopencl.Device, Context and CommandQueue).  The C interface
+ * takes host memory, so device arrays (pyopencl.array.Array) have to be
+ * read back with get() first.
+ *----------------------------------------------------------------------------*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <tricycl.h>
+
+static PyObject * tricycl_error = NULL;
+
+/*----------------------------------------------------------------------------*
+ * Raise tricycl.error for a failed call.
+ *----------------------------------------------------------------------------*/
+
+static PyObject * raise_error(int32_t ierr) {
+	switch(ierr) {
+		case TRICYCL_INVALID_TOKEN:
+			PyErr_Format(tricycl_error, "invalid token (%d)", ierr);
+			break;
+		case TRICYCL_INVALID_VALUE:
+			PyErr_Format(tricycl_error, "invalid value (%d)", ierr);
+			break;
+		case TRICYCL_OUT_OF_HOST_MEMORY:
+			PyErr_Format(tricycl_error, "out of host memory (%d)", ierr);
+			break;
+		default:
+			PyErr_Format(tricycl_error, "OpenCL error (%d)", ierr);
+			break;
+	} // switch
+
+	return NULL;
+} // raise_error
+
+/*----------------------------------------------------------------------------*
+ * OpenCL handle from an integer or an object with int_ptr.
+ *----------------------------------------------------------------------------*/
+
+static int handle(PyObject * object, void ** ptr) {
+	PyObject * value = PyObject_HasAttrString(object, "int_ptr") ?
+		PyObject_GetAttrString(object, "int_ptr") : (Py_INCREF(object), object);
+
+	if(value == NULL) {
+		return 0;
+	} // if
+
+	*ptr = PyLong_AsVoidPtr(value);
+	Py_DECREF(value);
+
+	return PyErr_Occurred() == NULL;
+} // handle
+
+/*----------------------------------------------------------------------------*
+ * Get a C-contiguous buffer of 1 or 2 dimensions with the given item size.
+ *----------------------------------------------------------------------------*/
+
+static int get_array(PyObject * object, Py_buffer * view, Py_ssize_t size,
+	int writable, const char * name) {
+	if(PyObject_GetBuffer(object, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT |
+		(writable ? PyBUF_WRITABLE : 0)) != 0) {
+		return 0;
+	} // if
+
+	// the format may carry a byte-order prefix ('<d', '=f')
+	const char * format = view->format == NULL ? "B" : view->format;
+	const char type = format[strlen(format)-1];
+
+	if(view->itemsize != size || (type != 'f' && type != 'd')) {
+		PyErr_Format(PyExc_TypeError, "%s must hold %s values", name,
+			size == sizeof(float) ? "float32" : "float64");
+		PyBuffer_Release(view);
+		return 0;
+	} // if
+
+	if(view->ndim < 1 || view->ndim > 2) {
+		PyErr_Format(PyExc_ValueError, "%s must have 1 or 2 dimensions",
+			name);
+		PyBuffer_Release(view);
+		return 0;
+	} // if
+
+	return 1;
+} // get_array
+
+/*----------------------------------------------------------------------------*
+ * Shape of a batch as (system_size, num_systems).
+ *----------------------------------------------------------------------------*/
+
+static void shape(const Py_buffer * view, size_t * system_size,
+	size_t * num_systems) {
+	*system_size = view->shape[view->ndim-1];
+	*num_systems = view->ndim == 2 ? view->shape[0] : 1;
+} // shape
+
+/*----------------------------------------------------------------------------*
+ * Initialization.
+ *----------------------------------------------------------------------------*/
+
+static PyObject * init(PyObject * args, int double_precision) {
+	PyObject * objects[3];
+	void * handles[3];
+
+	if(!PyArg_ParseTuple(args, "OOO", &objects[0], &objects[1],
+		&objects[2])) {
+		return NULL;
+	} // if
+
+	for(int i=0; i<3; ++i) {
+		if(!handle(objects[i], &handles[i])) {
+			return NULL;
+		} // if
+	} // for
+
+	size_t token;
+
+	// init builds the kernels, which may take a while
+	Py_BEGIN_ALLOW_THREADS
+	token = double_precision ?
+		tricycl_init_dp((cl_device_id)handles[0], (cl_context)handles[1],
+			(cl_command_queue)handles[2]) :
+		tricycl_init_sp((cl_device_id)handles[0], (cl_context)handles[1],
+			(cl_command_queue)handles[2]);
+	Py_END_ALLOW_THREADS
+
+	return PyLong_FromSize_t(token);
+} // init
+
+static PyObject * init_sp(PyObject * self, PyObject * args) {
+	return init(args, 0);
+} // init_sp
+
+static PyObject * init_dp(PyObject * self, PyObject * args) {
+	return init(args, 1);
+} // init_dp
+
+/*----------------------------------------------------------------------------*
+ * Solve.
+ *----------------------------------------------------------------------------*/
+
+static PyObject * solve(PyObject * args, int double_precision) {
+	const Py_ssize_t size = double_precision ? sizeof(double) : sizeof(float);
+	const char * names[5] = { "a", "b", "c", "d", "x" };
+	PyObject * objects[5];
+	Py_buffer views[5];
+	size_t token;
+	int got = 0;
+	int ok = 1;
+
+	if(!PyArg_ParseTuple(args, "nOOOOO", &token, &objects[0], &objects[1],
+		&objects[2], &objects[3], &objects[4])) {
+		return NULL;
+	} // if
+
+	for(; got<5 && ok; ++got) {
+		if(!get_array(objects[got], &views[got], size, got == 4,
+			names[got])) {
+			ok = 0;
+			break;
+		} // if
+	} // for
+
+	for(int i=0; i<4 && ok; ++i) {
+		if(views[i].len != views[4].len) {
+			PyErr_Format(PyExc_ValueError, "%s and x differ in size",
+				names[i]);
+			ok = 0;
+		} // if
+	} // for
+
+	size_t system_size = 0, num_systems = 0;
+	int32_t ierr = TRICYCL_SUCCESS;
+
+	if(ok) {
+		shape(&views[4], &system_size, &num_systems);
+
+		Py_BEGIN_ALLOW_THREADS
+		ierr = double_precision ?
+			tricycl_solve_dp(token, system_size, num_systems,
+				views[0].buf, views[1].buf, views[2].buf, views[3].buf,
+				views[4].buf) :
+			tricycl_solve_sp(token, system_size, num_systems,
+				views[0].buf, views[1].buf, views[2].buf, views[3].buf,
+				views[4].buf);
+		Py_END_ALLOW_THREADS
+	} // if
+
+	for(int i=0; i<got; ++i) {
+		PyBuffer_Release(&views[i]);
+	} // for
+
+	if(!ok) {
+		return NULL;
+	} // if
+
+	if(ierr != TRICYCL_SUCCESS) {
+		return raise_error(ierr);
+	} // if
+
+	Py_RETURN_NONE;
+} // solve
+
+static PyObject * solve_sp(PyObject * self, PyObject * args) {
+	return solve(args, 0);
+} // solve_sp
+
+static PyObject * solve_dp(PyObject * self, PyObject * args) {
+	return solve(args, 1);
+} // solve_dp
+
+/*----------------------------------------------------------------------------*
+ * Tune.
+ *----------------------------------------------------------------------------*/
+
+static PyObject * tune(PyObject * args, int double_precision) {
+	size_t token, system_size, num_systems;
+	int32_t ierr;
+
+	if(!PyArg_ParseTuple(args, "nnn", &token, &system_size, &num_systems)) {
+		return NULL;
+	} // if
+
+	Py_BEGIN_ALLOW_THREADS
+	ierr = double_precision ?
+		tricycl_tune_dp(token, system_size, num_systems) :
+		tricycl_tune_sp(token, system_size, num_systems);
+	Py_END_ALLOW_THREADS
+
+	if(ierr != TRICYCL_SUCCESS) {
+		return raise_error(ierr);
+	} // if
+
+	Py_RETURN_NONE;
+} // tune
+
+static PyObject * tune_sp(PyObject * self, PyObject * args) {
+	return tune(args, 0);
+} // tune_sp
+
+static PyObject * tune_dp(PyObject * self, PyObject * args) {
+	return tune(args, 1);
+} // tune_dp
+
+/*----------------------------------------------------------------------------*
+ * Module.
+ *----------------------------------------------------------------------------*/
+
+static PyMethodDef methods[] = {
+	{ "init_sp", init_sp, METH_VARARGS,
+		"init_sp(device, context, queue) -> token" },
+	{ "init_dp", init_dp, METH_VARARGS,
+		"init_dp(device, context, queue) -> token" },
+	{ "solve_sp", solve_sp, METH_VARARGS,
+		"solve_sp(token, a, b, c, d, x): float32 arrays, x written in place "
+		"(x may be d)" },
+	{ "solve_dp", solve_dp, METH_VARARGS,
+		"solve_dp(token, a, b, c, d, x): float64 arrays, x written in place "
+		"(x may be d)" },
+	{ "tune_sp", tune_sp, METH_VARARGS,
+		"tune_sp(token, system_size, num_systems)" },
+	{ "tune_dp", tune_dp, METH_VARARGS,
+		"tune_dp(token, system_size, num_systems)" },
+	{ NULL, NULL, 0, NULL }
+}; // methods
+
+static struct PyModuleDef module = {
+	PyModuleDef_HEAD_INIT, "tricycl",
+	"TriCyCL tridiagonal solvers", -1, methods, NULL, NULL, NULL, NULL
+}; // module
+
+PyMODINIT_FUNC PyInit_tricycl(void) {
+	PyObject * m = PyModule_Create(&module);
+
+	if(m == NULL) {
+		return NULL;
+	} // if
+
+	tricycl_error = PyErr_NewException("tricycl.error", PyExc_RuntimeError,
+		NULL);
+	Py_XINCREF(tricycl_error);
+
+	if(PyModule_AddObject(m, "error", tricycl_error) < 0) {
+		Py_XDECREF(tricycl_error);
+		Py_CLEAR(tricycl_error);
+		Py_DECREF(m);
+		return NULL;
+	} // if
+
+	return m;
+} // PyInit_tricycl
@@ -24,36 +24,48 @@
  * NVIDIA, Nikolai Sakharnykh, 2009
  */
 
-//#define NATIVE_DIVIDE
+/*
+ * NATIVE_DIVIDE is defined by the host (single precision only) when the
+ * tuning database selects native division for a problem shape.
+ *
+ * SYSTEM_SIZE and ITERATIONS are defined by the host when it builds a
+ * variant of pcr_branch_free_kernel specialized for one system size.
+ * The runtime arguments are then ignored, so the reduction loop can be
+ * unrolled and the index masks folded.
+ */
 
 #pragma OPENCL EXTENSION cl_khr_fp64 : enable
 //#pragma OPENCL EXTENSION cl_amd_printf : enable
 
-__kernel void pcr_branch_free_kernel(__global real_t *a_d,
-	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
-	__global real_t *x_d, __local real_t *shared, int system_size,
-	int num_systems, int iterations) {
-	size_t thid = get_local_id(0);
-	size_t blid = get_group_id(0);
+/*
+ * Parallel cyclic reduction of one system held in local memory, one
+ * work-item per row.  The solution is left in x.
+ *
+ * If flags is not NULL, the reduction stops early once every row
+ * satisfies |a| + |c| <= epsilon |b|, and the rows are then solved as
+ * decoupled.  flags are two local words: a row that has not converged
+ * sets the flag of the current level, and the other flag is cleared for
+ * the next level, so the test needs no extra barriers.
+ */
 
+inline void pcr_local(__local real_t * a, __local real_t * b,
+	__local real_t * c, __local real_t * d, __local real_t * x,
+	int thid, int system_size, int iterations, __local real_t * flags) {
+	const real_t epsilon = sizeof(real_t) == 4 ? FLT_EPSILON : DBL_EPSILON;
 	int delta = 1;
-
-	__local real_t * a = shared;
-	__local real_t * b = &a[system_size+1];
-	__local real_t * c = &b[system_size+1];
-	__local real_t * d = &c[system_size+1];
-	__local real_t * x = &d[system_size+1];
-
-	a[thid] = a_d[thid + blid * system_size];
-	b[thid] = b_d[thid + blid * system_size];
-	c[thid] = c_d[thid + blid * system_size];
-	d[thid] = d_d[thid + blid * system_size];
-
+	bool converged = false;
 	real_t aNew, bNew, cNew, dNew;
+
+	if (flags != NULL && thid == 0) {
+		flags[0] = 0.0;
+	} // if
   
 	barrier(CLK_LOCAL_MEM_FENCE);
 
 	// parallel cyclic reduction
+#if defined(ITERATIONS)
+#pragma unroll
+#endif
 	for (int j = 0; j < iterations; j++) {
 		int i = thid;
 
@@ -76,18 +88,40 @@ __kernel void pcr_branch_free_kernel(__global real_t *a_d,
 		aNew = -a[iLeft] * tmp1;
 		cNew = -c[iRight] * tmp2;
 
+		if (flags != NULL &&
+			fabs(aNew) + fabs(cNew) > epsilon * fabs(bNew)) {
+			flags[j & 1] = 1.0;
+		} // if
+
 		barrier(CLK_LOCAL_MEM_FENCE);
         
 		b[i] = bNew;
  		d[i] = dNew;
 		a[i] = aNew;
 		c[i] = cNew;	
+
+		if (flags != NULL && thid == 0) {
+			flags[(j + 1) & 1] = 0.0;
+		} // if
     
 		delta *= 2;
 		barrier(CLK_LOCAL_MEM_FENCE);
+
+		// the same for the whole work group
+		if (flags != NULL && flags[j & 1] == 0.0) {
+			converged = true;
+			break;
+		} // if
 	} // for
 
-	if (thid < delta) {
+	if (converged) {
+#ifndef NATIVE_DIVIDE
+		x[thid] = d[thid] / b[thid];
+#else
+		x[thid] = native_divide(d[thid], b[thid]);
+#endif
+	}
+	else if (thid < delta) {
 		int addr1 = thid;
 		int addr2 = thid + delta;
 		real_t tmp3 = b[addr2] * b[addr1] - c[addr1] * a[addr2];
@@ -103,10 +137,621 @@ __kernel void pcr_branch_free_kernel(__global real_t *a_d,
 	} // if
     
 	barrier(CLK_LOCAL_MEM_FENCE);
-    
+} // pcr_local
+
+#if defined(SYSTEM_SIZE)
+__attribute__((reqd_work_group_size(SYSTEM_SIZE, 1, 1)))
+#endif
+__kernel void pcr_branch_free_kernel(__global real_t *a_d,
+	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
+	__global real_t *x_d, __local real_t *shared, int _system_size,
+	int num_systems, int _iterations) {
+	size_t thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+
+#if defined(SYSTEM_SIZE)
+	const int system_size = SYSTEM_SIZE;
+	const int iterations = ITERATIONS;
+#else
+	const int system_size = _system_size;
+	const int iterations = _iterations;
+#endif
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[system_size+1];
+	__local real_t * c = &b[system_size+1];
+	__local real_t * d = &c[system_size+1];
+	__local real_t * x = &d[system_size+1];
+
+	a[thid] = a_d[thid + blid * system_size];
+	b[thid] = b_d[thid + blid * system_size];
+	c[thid] = c_d[thid + blid * system_size];
+	d[thid] = d_d[thid + blid * system_size];
+
+	pcr_local(a, b, c, d, x, thid, system_size, iterations, NULL);
+
 	x_d[thid + blid * system_size] = x[thid];
 } // pcr_branch_free_kernel
 
+/*
+ * pcr_branch_free_kernel for rows packed as {a, b, c, d}: each work-item
+ * reads its row with one vector load.
+ */
+
+__kernel void pcr_packed_kernel(__global const real_t *rows_d,
+	__global real_t *x_d, __local real_t *shared, int system_size,
+	int iterations) {
+	size_t thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[system_size+1];
+	__local real_t * c = &b[system_size+1];
+	__local real_t * d = &c[system_size+1];
+	__local real_t * x = &d[system_size+1];
+
+	const real4_t row = vload4(thid + blid * system_size, rows_d);
+
+	a[thid] = row.x;
+	b[thid] = row.y;
+	c[thid] = row.z;
+	d[thid] = row.w;
+
+	pcr_local(a, b, c, d, x, thid, system_size, iterations, NULL);
+
+	x_d[thid + blid * system_size] = x[thid];
+} // pcr_packed_kernel
+
+/*
+ * pcr_branch_free_kernel for systems whose off-diagonals decay quickly
+ * (e.g. diagonally dominant): iterations is an upper bound, and the
+ * reduction ends at the first level where the off-diagonals are below
+ * working precision.
+ */
+
+#if defined(SYSTEM_SIZE)
+__attribute__((reqd_work_group_size(SYSTEM_SIZE, 1, 1)))
+#endif
+__kernel void pcr_adaptive_kernel(__global real_t *a_d,
+	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
+	__global real_t *x_d, __local real_t *shared, int _system_size,
+	int num_systems, int _iterations) {
+	size_t thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+
+#if defined(SYSTEM_SIZE)
+	const int system_size = SYSTEM_SIZE;
+	const int iterations = ITERATIONS;
+#else
+	const int system_size = _system_size;
+	const int iterations = _iterations;
+#endif
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[system_size+1];
+	__local real_t * c = &b[system_size+1];
+	__local real_t * d = &c[system_size+1];
+	__local real_t * x = &d[system_size+1];
+	__local real_t * flags = &x[system_size+1];
+
+	a[thid] = a_d[thid + blid * system_size];
+	b[thid] = b_d[thid + blid * system_size];
+	c[thid] = c_d[thid + blid * system_size];
+	d[thid] = d_d[thid + blid * system_size];
+
+	pcr_local(a, b, c, d, x, thid, system_size, iterations, flags);
+
+	x_d[thid + blid * system_size] = x[thid];
+} // pcr_adaptive_kernel
+
+/*
+ * pcr_local for symmetric systems (a[i] == c[i-1]).  Every reduction
+ * level keeps the system symmetric, so the sub-diagonal at distance delta
+ * is c[i-delta] and only b, c, d and x are stored: four reals per row
+ * instead of five.
+ */
+
+inline void pcr_symmetric_local(__local real_t * b, __local real_t * c,
+	__local real_t * d, __local real_t * x, int thid, int system_size,
+	int iterations) {
+	int delta = 1;
+	real_t bNew, cNew, dNew;
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int j = 0; j < iterations; j++) {
+		int i = thid;
+		int iRight = (i+delta) & (system_size-1);
+		int iLeft = (i-delta) & (system_size-1);
+
+#ifndef NATIVE_DIVIDE
+		real_t tmp1 = c[iLeft] / b[iLeft];
+		real_t tmp2 = c[i] / b[iRight];
+#else
+		real_t tmp1 = native_divide(c[iLeft], b[iLeft]);
+		real_t tmp2 = native_divide(c[i], b[iRight]);
+#endif
+
+		bNew = b[i] - c[iLeft] * tmp1 - c[i] * tmp2;
+		dNew = d[i] - d[iLeft] * tmp1 - d[iRight] * tmp2;
+		cNew = -c[iRight] * tmp2;
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		b[i] = bNew;
+		d[i] = dNew;
+		c[i] = cNew;
+
+		delta *= 2;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	} // for
+
+	if (thid < delta) {
+		int addr1 = thid;
+		int addr2 = thid + delta;
+		real_t tmp3 = b[addr2] * b[addr1] - c[addr1] * c[addr1];
+#ifndef NATIVE_DIVIDE
+		x[addr1] = (b[addr2] * d[addr1] - c[addr1] * d[addr2]) / tmp3;
+		x[addr2] = (d[addr2] * b[addr1] - d[addr1] * c[addr1]) / tmp3;
+#else
+		x[addr1] = native_divide((b[addr2] * d[addr1] - c[addr1] *
+			d[addr2]), tmp3);
+		x[addr2] = native_divide((d[addr2] * b[addr1] - d[addr1] *
+			c[addr1]), tmp3);
+#endif
+	} // if
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+} // pcr_symmetric_local
+
+/*
+ * pcr_branch_free_kernel for symmetric systems: b_d is the diagonal and
+ * c_d the off-diagonal, c_d[i] coupling rows i and i+1.  c of the last
+ * row of each system is ignored.
+ */
+
+__kernel void pcr_symmetric_kernel(__global real_t *b_d,
+	__global real_t *c_d, __global real_t *d_d, __global real_t *x_d,
+	__local real_t *shared, int system_size, int iterations) {
+	size_t thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+
+	__local real_t * b = shared;
+	__local real_t * c = &b[system_size+1];
+	__local real_t * d = &c[system_size+1];
+	__local real_t * x = &d[system_size+1];
+
+	b[thid] = b_d[thid + blid * system_size];
+	c[thid] = thid < system_size-1 ? c_d[thid + blid * system_size] : 0.0;
+	d[thid] = d_d[thid + blid * system_size];
+
+	pcr_symmetric_local(b, c, d, x, thid, system_size, iterations);
+
+	x_d[thid + blid * system_size] = x[thid];
+} // pcr_symmetric_kernel
+
+/*
+ * Sub-system solve for truncated SPIKE: the first and last row of each
+ * sub-system are replaced by the approximate interface values in ix
+ * (first, last per work group), which the host computes from the
+ * neighboring partitions only.  This replaces the interface PCR launch
+ * and the uncouple kernel of the exact solve.
+ */
+
+__kernel void pcr_truncated_kernel(__global real_t *a_d,
+	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
+	__global real_t *x_d, __global real_t *ix, __local real_t *shared,
+	int system_size, int iterations) {
+	size_t thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[system_size+1];
+	__local real_t * c = &b[system_size+1];
+	__local real_t * d = &c[system_size+1];
+	__local real_t * x = &d[system_size+1];
+
+	const size_t row = thid + blid * system_size;
+
+	if(thid == 0 || thid == system_size-1) {
+		a[thid] = 0.0;
+		b[thid] = 1.0;
+		c[thid] = 0.0;
+		d[thid] = ix[2*blid + (thid == 0 ? 0 : 1)];
+	}
+	else {
+		a[thid] = a_d[row];
+		b[thid] = b_d[row];
+		c[thid] = c_d[row];
+		d[thid] = d_d[row];
+	} // if
+
+	pcr_local(a, b, c, d, x, thid, system_size, iterations, NULL);
+
+	x_d[row] = x[thid];
+} // pcr_truncated_kernel
+
+/*
+ * Solves the lines of a strided 2-D or 3-D grid in the caller's layout,
+ * one work group per line.  Rows of a line are stride elements apart, and
+ * line l starts at (l % lines0)*stride0 + (l / lines0)*stride1, where
+ * lines0 is the extent of the first of the two remaining axes.  The work
+ * group may be larger than the line (a power of two); the extra
+ * work-items hold identity rows, which do not couple to the line.
+ */
+
+__kernel void pcr_strided_kernel(__global real_t *a_d,
+	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
+	__global real_t *x_d, __local real_t *shared, int system_size,
+	int iterations, long stride, long lines0, long stride0, long stride1) {
+	size_t thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+	const int items = get_local_size(0);
+	const bool active = thid < system_size;
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[items+1];
+	__local real_t * c = &b[items+1];
+	__local real_t * d = &c[items+1];
+	__local real_t * x = &d[items+1];
+
+	const size_t row = (blid % lines0) * stride0 + (blid / lines0) * stride1 +
+		thid * stride;
+
+	// the coefficients outside the line are ignored, as in Thomas
+	a[thid] = thid == 0 || !active ? 0.0 : a_d[row];
+	b[thid] = active ? b_d[row] : 1.0;
+	c[thid] = thid >= system_size-1 ? 0.0 : c_d[row];
+	d[thid] = active ? d_d[row] : 0.0;
+
+	pcr_local(a, b, c, d, x, thid, items, iterations, NULL);
+
+	if (active) {
+		x_d[row] = x[thid];
+	} // if
+} // pcr_strided_kernel
+
+/*
+ * Sub-system solve with rows consecutive rows per work-item (4 <= rows <=
+ * PCR_MAX_ROWS), so a work group of system_size/rows work-items solves
+ * the whole sub-system.  Each work-item first eliminates its interior
+ * rows in private memory, leaving its first and last row coupled only to
+ * each other and to the neighboring blocks.  One step of cyclic reduction
+ * on these rows leaves one row per work-item, which is solved with PCR in
+ * local memory, and the last and interior rows are then recovered by
+ * substitution.
+ */
+
+#define PCR_MAX_ROWS 16
+
+__kernel void pcr_rows_kernel(__global real_t *a_d,
+	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
+	__global real_t *x_d, __local real_t *shared, int system_size,
+	int rows, int iterations) {
+	int thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+	const int items = system_size / rows;
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[items+1];
+	__local real_t * c = &b[items+1];
+	__local real_t * d = &c[items+1];
+	__local real_t * x = &d[items+1];
+	__local real_t * la = &x[items+1];
+	__local real_t * lc = &la[items];
+	__local real_t * ld = &lc[items];
+
+	const size_t first = blid * system_size + thid * rows;
+	real_t pa[PCR_MAX_ROWS], pc[PCR_MAX_ROWS], pd[PCR_MAX_ROWS];
+	real_t r;
+
+	// forward: row k couples to the first row of the block and to row k+1
+	for (int k = 0; k < 2; k++) {
+		r = 1.0 / b_d[first + k];
+		pa[k] = r * a_d[first + k];
+		pc[k] = r * c_d[first + k];
+		pd[k] = r * d_d[first + k];
+	} // for
+
+	for (int k = 2; k < rows; k++) {
+		const real_t ak = a_d[first + k];
+		r = 1.0 / (b_d[first + k] - ak * pc[k-1]);
+		pa[k] = -r * ak * pa[k-1];
+		pc[k] = r * c_d[first + k];
+		pd[k] = r * (d_d[first + k] - ak * pd[k-1]);
+	} // for
+
+	// backward: interior rows couple to the first and last row only
+	for (int k = rows-3; k > 0; k--) {
+		pd[k] -= pc[k] * pd[k+1];
+		pa[k] -= pc[k] * pa[k+1];
+		pc[k] = -pc[k] * pc[k+1];
+	} // for
+
+	r = 1.0 / (1.0 - pc[0] * pa[1]);
+	pd[0] = r * (pd[0] - pc[0] * pd[1]);
+	pa[0] = r * pa[0];
+	pc[0] = -r * pc[0] * pc[1];
+
+	la[thid] = pa[rows-1];
+	lc[thid] = pc[rows-1];
+	ld[thid] = pd[rows-1];
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// eliminate the last rows, leaving the first rows tridiagonal
+	const int left = (thid - 1) & (items-1);
+
+	a[thid] = -pa[0] * la[left];
+	b[thid] = 1.0 - pa[0] * lc[left] - pc[0] * pa[rows-1];
+	c[thid] = -pc[0] * pc[rows-1];
+	d[thid] = pd[0] - pa[0] * ld[left] - pc[0] * pd[rows-1];
+
+	pcr_local(a, b, c, d, x, thid, items, iterations, NULL);
+
+	const real_t xFirst = x[thid];
+	const real_t xLast = pd[rows-1] - pa[rows-1] * xFirst -
+		pc[rows-1] * x[(thid + 1) & (items-1)];
+
+	x_d[first] = xFirst;
+
+	for (int k = 1; k < rows-1; k++) {
+		x_d[first + k] = pd[k] - pa[k] * xFirst - pc[k] * xLast;
+	} // for
+
+	x_d[first + rows-1] = xLast;
+} // pcr_rows_kernel
+
+/*
+ * pcr_rows_kernel for any number of rows per work-item (at least 4): the
+ * eliminated rows are kept in a_d, c_d and d_d instead of private memory,
+ * which are overwritten.  A whole system that splits into a power of two
+ * blocks is then reduced, its interface solved and the rows substituted
+ * in a single launch, with no host-side interface system and no uncouple
+ * step.
+ */
+
+__kernel void pcr_fused_kernel(__global real_t *a_d,
+	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
+	__global real_t *x_d, __local real_t *shared, int system_size,
+	int rows, int iterations) {
+	int thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+	const int items = system_size / rows;
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[items+1];
+	__local real_t * c = &b[items+1];
+	__local real_t * d = &c[items+1];
+	__local real_t * x = &d[items+1];
+	__local real_t * la = &x[items+1];
+	__local real_t * lc = &la[items];
+	__local real_t * ld = &lc[items];
+
+	const size_t first = blid * system_size + thid * rows;
+	__global real_t * pa = &a_d[first];
+	__global const real_t * pb = &b_d[first];
+	__global real_t * pc = &c_d[first];
+	__global real_t * pd = &d_d[first];
+	real_t r;
+
+	// forward: row k couples to the first row of the block and to row k+1
+	for (int k = 0; k < 2; k++) {
+		r = 1.0 / pb[k];
+		pa[k] *= r;
+		pc[k] *= r;
+		pd[k] *= r;
+	} // for
+
+	for (int k = 2; k < rows; k++) {
+		const real_t ak = pa[k];
+		r = 1.0 / (pb[k] - ak * pc[k-1]);
+		pa[k] = -r * ak * pa[k-1];
+		pc[k] *= r;
+		pd[k] = r * (pd[k] - ak * pd[k-1]);
+	} // for
+
+	// backward: interior rows couple to the first and last row only
+	for (int k = rows-3; k > 0; k--) {
+		pd[k] -= pc[k] * pd[k+1];
+		pa[k] -= pc[k] * pa[k+1];
+		pc[k] = -pc[k] * pc[k+1];
+	} // for
+
+	r = 1.0 / (1.0 - pc[0] * pa[1]);
+	pd[0] = r * (pd[0] - pc[0] * pd[1]);
+	pa[0] = r * pa[0];
+	pc[0] = -r * pc[0] * pc[1];
+
+	la[thid] = pa[rows-1];
+	lc[thid] = pc[rows-1];
+	ld[thid] = pd[rows-1];
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// eliminate the last rows, leaving the first rows tridiagonal
+	const int left = (thid - 1) & (items-1);
+
+	a[thid] = -pa[0] * la[left];
+	b[thid] = 1.0 - pa[0] * lc[left] - pc[0] * pa[rows-1];
+	c[thid] = -pc[0] * pc[rows-1];
+	d[thid] = pd[0] - pa[0] * ld[left] - pc[0] * pd[rows-1];
+
+	pcr_local(a, b, c, d, x, thid, items, iterations, NULL);
+
+	const real_t xFirst = x[thid];
+	const real_t xLast = pd[rows-1] - pa[rows-1] * xFirst -
+		pc[rows-1] * x[(thid + 1) & (items-1)];
+
+	// x_d may be d_d: each row of d is read before it is written
+	for (int k = 1; k < rows-1; k++) {
+		x_d[first + k] = pd[k] - pa[k] * xFirst - pc[k] * xLast;
+	} // for
+
+	x_d[first] = xFirst;
+	x_d[first + rows-1] = xLast;
+} // pcr_fused_kernel
+
+/*
+ * pcr_fused_kernel for systems of different sizes, one work group per
+ * system.  System systems[first + group] occupies rows offsets[system] to
+ * offsets[system+1]-1.  Its rows are split into at most one block (of at
+ * least 3 rows) per work-item; work-items without a block hold identity
+ * rows of the reduced system.  Systems of fewer than 3 rows are solved
+ * directly by the first work-item.  a_d, c_d and d_d are overwritten.
+ */
+
+__kernel void pcr_ragged_kernel(__global real_t *a_d,
+	__global real_t *b_d, __global real_t *c_d, __global real_t *d_d,
+	__global real_t *x_d, __global const uint *offsets,
+	__global const uint *systems, __local real_t *shared, int first,
+	int iterations) {
+	int thid = get_local_id(0);
+	const int items = get_local_size(0);
+	const uint system = systems[first + get_group_id(0)];
+	const uint start = offsets[system];
+	const uint system_size = offsets[system + 1] - start;
+	const int blocks = min((uint)items, system_size / 3);
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[items+1];
+	__local real_t * c = &b[items+1];
+	__local real_t * d = &c[items+1];
+	__local real_t * x = &d[items+1];
+	__local real_t * la = &x[items+1];
+	__local real_t * lc = &la[items];
+	__local real_t * ld = &lc[items];
+
+	const bool active = thid < blocks;
+	const uint lo = active ?
+		start + (uint)(((ulong)thid * system_size) / blocks) : start;
+	const int rows = active ?
+		start + (uint)(((ulong)(thid + 1) * system_size) / blocks) - lo : 0;
+
+	__global real_t * pa = &a_d[lo];
+	__global const real_t * pb = &b_d[lo];
+	__global real_t * pc = &c_d[lo];
+	__global real_t * pd = &d_d[lo];
+	real_t r;
+
+	if (active) {
+		// a of the first and c of the last row of a system are ignored
+		if (thid == 0) {
+			pa[0] = 0.0;
+		} // if
+
+		if (thid == blocks-1) {
+			pc[rows-1] = 0.0;
+		} // if
+
+		for (int k = 0; k < 2; k++) {
+			r = 1.0 / pb[k];
+			pa[k] *= r;
+			pc[k] *= r;
+			pd[k] *= r;
+		} // for
+
+		for (int k = 2; k < rows; k++) {
+			const real_t ak = pa[k];
+			r = 1.0 / (pb[k] - ak * pc[k-1]);
+			pa[k] = -r * ak * pa[k-1];
+			pc[k] *= r;
+			pd[k] = r * (pd[k] - ak * pd[k-1]);
+		} // for
+
+		for (int k = rows-3; k > 0; k--) {
+			pd[k] -= pc[k] * pd[k+1];
+			pa[k] -= pc[k] * pa[k+1];
+			pc[k] = -pc[k] * pc[k+1];
+		} // for
+
+		r = 1.0 / (1.0 - pc[0] * pa[1]);
+		pd[0] = r * (pd[0] - pc[0] * pd[1]);
+		pa[0] = r * pa[0];
+		pc[0] = -r * pc[0] * pc[1];
+
+		la[thid] = pa[rows-1];
+		lc[thid] = pc[rows-1];
+		ld[thid] = pd[rows-1];
+	}
+	else {
+		la[thid] = 0.0;
+		lc[thid] = 0.0;
+		ld[thid] = 0.0;
+	} // if
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (active) {
+		const int left = (thid - 1) & (items-1);
+
+		a[thid] = -pa[0] * la[left];
+		b[thid] = 1.0 - pa[0] * lc[left] - pc[0] * pa[rows-1];
+		c[thid] = -pc[0] * pc[rows-1];
+		d[thid] = pd[0] - pa[0] * ld[left] - pc[0] * pd[rows-1];
+	}
+	else {
+		a[thid] = 0.0;
+		b[thid] = 1.0;
+		c[thid] = 0.0;
+		d[thid] = 0.0;
+	} // if
+
+	pcr_local(a, b, c, d, x, thid, items, iterations, NULL);
+
+	if (active) {
+		const real_t xFirst = x[thid];
+		const real_t xLast = pd[rows-1] - pa[rows-1] * xFirst -
+			pc[rows-1] * x[(thid + 1) & (items-1)];
+
+		for (int k = 1; k < rows-1; k++) {
+			x_d[lo + k] = pd[k] - pa[k] * xFirst - pc[k] * xLast;
+		} // for
+
+		x_d[lo] = xFirst;
+		x_d[lo + rows-1] = xLast;
+	}
+	else if (thid == 0 && system_size == 1) {
+		x_d[start] = d_d[start] / b_d[start];
+	}
+	else if (thid == 0 && system_size == 2) {
+		r = 1.0 / (b_d[start] * b_d[start+1] - c_d[start] * a_d[start+1]);
+		x_d[start] = r * (d_d[start] * b_d[start+1] -
+			c_d[start] * d_d[start+1]);
+		x_d[start+1] = r * (b_d[start] * d_d[start+1] -
+			a_d[start+1] * d_d[start]);
+	} // if
+} // pcr_ragged_kernel
+
+/*
+ * One PCR level for sub-systems that do not fit in local memory, one
+ * work-item per row, from a..d into a2..d2.  After the levels with
+ * delta = 1, 2, ..., 2^(k-1), rows i, i+2^k, ... of each sub-system form
+ * independent systems, which pcr_strided_kernel then solves in local
+ * memory.
+ */
+
+__kernel void pcr_global_kernel(__global const real_t *a,
+	__global const real_t *b, __global const real_t *c,
+	__global const real_t *d, __global real_t *a2, __global real_t *b2,
+	__global real_t *c2, __global real_t *d2, int system_size, int delta) {
+	const size_t row = get_global_id(0);
+	const size_t mask = system_size-1;
+	const size_t i = row & mask;
+	const size_t base = row - i;
+
+	const size_t iLeft = base + ((i - delta) & mask);
+	const size_t iRight = base + ((i + delta) & mask);
+
+	const real_t tmp1 = a[row] / b[iLeft];
+	const real_t tmp2 = c[row] / b[iRight];
+
+	b2[row] = b[row] - c[iLeft] * tmp1 - a[iRight] * tmp2;
+	d2[row] = d[row] - d[iLeft] * tmp1 - d[iRight] * tmp2;
+	a2[row] = -a[iLeft] * tmp1;
+	c2[row] = -c[iRight] * tmp2;
+} // pcr_global_kernel
+
 /*
  * Written by Ben Bergen for TriCyCL, June 2012
  *
@@ -133,6 +778,318 @@ __kernel void uncouple(__global real_t * a, __global real_t * b,
 	d[foff] = ix[ioff];
 } // uncouple
 
+/*
+ * uncouple for symmetric systems.  The interface rows become identity
+ * rows and their couplings to the neighbouring interior rows are moved to
+ * the right-hand side, which keeps the sub-systems symmetric.  Needs
+ * sub_size >= 4, so that the rows next to the first and the last row of
+ * a sub-system are distinct.
+ */
+
+__kernel void uncouple_symmetric(__global real_t * b, __global real_t * c,
+	__global real_t * d, __global const real_t * ix, int system_size,
+	int sub_size) {
+	size_t thid = get_local_id(0);
+	size_t blid = get_group_id(0);
+	size_t wgsz = get_local_size(0);
+
+	size_t ioff = blid*wgsz + thid%wgsz;
+	size_t foff = blid*system_size + (thid/2)*sub_size +
+		(thid%2)*(sub_size-1);
+	const real_t x = ix[ioff];
+
+	if (thid%2 == 0) {
+		d[foff+1] -= c[foff] * x;
+	}
+	else {
+		d[foff-1] -= c[foff-1] * x;
+		c[foff-1] = 0.0;
+	} // if
+
+	b[foff] = 1.0;
+	c[foff] = 0.0;
+	d[foff] = x;
+} // uncouple_symmetric
+
+/*
+ * Thomas algorithm with one work-item per system, for batches with enough
+ * systems to fill the device.  A work group of wgsz systems moves through
+ * its systems in tiles of THOMAS_TILE rows: the tile is loaded into local
+ * memory with consecutive work-items reading consecutive rows of a
+ * system, so the global loads are coalesced although each work-item then
+ * sweeps its own system.  The forward sweep stores the modified c in cp
+ * and the modified d in x, which the backward sweep reads tile by tile in
+ * reverse and overwrites with the solution.  Each tile is read before it
+ * is written, so cp may be c and x may be d for an in-place solve.  The
+ * tiles are padded by one row against bank conflicts.  a of the first and
+ * c of the last row of each system are ignored.
+ */
+
+#define THOMAS_TILE 16
+
+__kernel void thomas_kernel(__global const real_t * a,
+	__global const real_t * b, __global real_t * c, __global real_t * d,
+	__global real_t * cp, __global real_t * x, __local real_t * shared,
+	int system_size, int num_systems) {
+	const size_t thid = get_local_id(0);
+	const size_t wgsz = get_local_size(0);
+	const size_t first = get_group_id(0) * wgsz;
+	const size_t pitch = THOMAS_TILE + 1;
+	const size_t tiles = (system_size + THOMAS_TILE - 1) / THOMAS_TILE;
+
+	__local real_t * ta = shared;
+	__local real_t * tb = &ta[wgsz*pitch];
+	__local real_t * tc = &tb[wgsz*pitch];
+	__local real_t * td = &tc[wgsz*pitch];
+
+	// this work-item's rows of the tile
+	__local real_t * ra = &ta[thid*pitch];
+	__local real_t * rb = &tb[thid*pitch];
+	__local real_t * rc = &tc[thid*pitch];
+	__local real_t * rd = &td[thid*pitch];
+	real_t c_prev = 0.0;
+	real_t d_prev = 0.0;
+
+	for (size_t t = 0; t < tiles; ++t) {
+		const size_t base = t * THOMAS_TILE;
+
+		// coalesced load: work-items step through rows, then systems
+		for (size_t l = thid; l < wgsz*THOMAS_TILE; l += wgsz) {
+			const size_t s = l / THOMAS_TILE;
+			const size_t i = base + l % THOMAS_TILE;
+
+			if (first + s < num_systems && i < system_size) {
+				const size_t g = (first + s) * system_size + i;
+				const size_t o = s*pitch + l % THOMAS_TILE;
+
+				ta[o] = a[g];
+				tb[o] = b[g];
+				tc[o] = c[g];
+				td[o] = d[g];
+			} // if
+		} // for
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (size_t r = 0; r < THOMAS_TILE && base + r < system_size; ++r) {
+			const real_t sub = base + r == 0 ? 0.0 : ra[r];
+			const real_t sup = base + r == system_size-1 ? 0.0 : rc[r];
+			const real_t inv = 1.0 / (rb[r] - sub * c_prev);
+
+			c_prev = sup * inv;
+			d_prev = (rd[r] - sub * d_prev) * inv;
+
+			rc[r] = c_prev;
+			rd[r] = d_prev;
+		} // for
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (size_t l = thid; l < wgsz*THOMAS_TILE; l += wgsz) {
+			const size_t s = l / THOMAS_TILE;
+			const size_t i = base + l % THOMAS_TILE;
+
+			if (first + s < num_systems && i < system_size) {
+				const size_t g = (first + s) * system_size + i;
+				const size_t o = s*pitch + l % THOMAS_TILE;
+
+				cp[g] = tc[o];
+				x[g] = td[o];
+			} // if
+		} // for
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	} // for
+
+	real_t x_next = 0.0;
+
+	for (size_t t = tiles; t-- > 0;) {
+		const size_t base = t * THOMAS_TILE;
+
+		for (size_t l = thid; l < wgsz*THOMAS_TILE; l += wgsz) {
+			const size_t s = l / THOMAS_TILE;
+			const size_t i = base + l % THOMAS_TILE;
+
+			if (first + s < num_systems && i < system_size) {
+				const size_t g = (first + s) * system_size + i;
+				const size_t o = s*pitch + l % THOMAS_TILE;
+
+				tc[o] = cp[g];
+				td[o] = x[g];
+			} // if
+		} // for
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (size_t r = THOMAS_TILE; r-- > 0;) {
+			if (base + r < system_size) {
+				x_next = rd[r] - rc[r] * x_next;
+				rd[r] = x_next;
+			} // if
+		} // for
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (size_t l = thid; l < wgsz*THOMAS_TILE; l += wgsz) {
+			const size_t s = l / THOMAS_TILE;
+			const size_t i = base + l % THOMAS_TILE;
+
+			if (first + s < num_systems && i < system_size) {
+				x[(first + s) * system_size + i] =
+					td[s*pitch + l % THOMAS_TILE];
+			} // if
+		} // for
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	} // for
+} // thomas_kernel
+
+/*
+ * Residual norms of solved systems, one work group per system:
+ * norms[2*s] = ||d - A x||_2 and norms[2*s+1] = ||d - A x||_inf.  The
+ * work group size is a power of two and need not divide system_size; a
+ * of the first and c of the last row are ignored.
+ */
+
+__kernel void residual_norms(__global const real_t * a,
+	__global const real_t * b, __global const real_t * c,
+	__global const real_t * d, __global const real_t * x,
+	__global real_t * norms, __local real_t * scratch, int system_size) {
+	const int thid = get_local_id(0);
+	const int size = get_local_size(0);
+	const size_t blid = get_group_id(0);
+	const size_t base = blid * system_size;
+
+	__local real_t * sum = scratch;
+	__local real_t * peak = &scratch[size];
+
+	real_t s = 0.0;
+	real_t p = 0.0;
+
+	for (int i = thid; i < system_size; i += size) {
+		real_t r = d[base + i] - b[base + i] * x[base + i];
+
+		if (i > 0) {
+			r -= a[base + i] * x[base + i - 1];
+		} // if
+
+		if (i < system_size - 1) {
+			r -= c[base + i] * x[base + i + 1];
+		} // if
+
+		s += r * r;
+		p = fmax(p, fabs(r));
+	} // for
+
+	sum[thid] = s;
+	peak[thid] = p;
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int stride = size / 2; stride > 0; stride /= 2) {
+		if (thid < stride) {
+			sum[thid] += sum[thid + stride];
+			peak[thid] = fmax(peak[thid], peak[thid + stride]);
+		} // if
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	} // for
+
+	if (thid == 0) {
+		norms[2 * blid] = sqrt(sum[0]);
+		norms[2 * blid + 1] = peak[0];
+	} // if
+} // residual_norms
+
+/*
+ * One damped line-Jacobi sweep, one work group per line and one work-item
+ * per row: r = f - A u, T x = r with T the in-line tridiagonal part of A,
+ * u_out = u_in + omega x.  s and n couple row i of line l to row i of
+ * lines l-1 and l+1; they are ignored on the first and last line, as are
+ * a of the first and c of the last row of each line.  The work group may
+ * be larger than the line (a power of two); the extra work-items hold
+ * identity rows with a zero residual.
+ */
+
+__kernel void line_smooth(__global const real_t * a_d,
+	__global const real_t * b_d, __global const real_t * c_d,
+	__global const real_t * s_d, __global const real_t * n_d,
+	__global const real_t * f_d, __global const real_t * u_in,
+	__global real_t * u_out, __local real_t * shared, int system_size,
+	int num_lines, int iterations, real_t omega) {
+	const int thid = get_local_id(0);
+	const int blid = get_group_id(0);
+	const int items = get_local_size(0);
+	const size_t i = (size_t)blid * system_size + thid;
+
+	__local real_t * a = shared;
+	__local real_t * b = &a[items+1];
+	__local real_t * c = &b[items+1];
+	__local real_t * d = &c[items+1];
+	__local real_t * x = &d[items+1];
+
+	const bool active = thid < system_size;
+	real_t r = 0.0;
+
+	a[thid] = thid > 0 && active ? a_d[i] : 0.0;
+	b[thid] = active ? b_d[i] : 1.0;
+	c[thid] = thid < system_size-1 ? c_d[i] : 0.0;
+
+	if (active) {
+		r = f_d[i] - b[thid] * u_in[i];
+
+		if (thid > 0) {
+			r -= a[thid] * u_in[i-1];
+		} // if
+
+		if (thid < system_size-1) {
+			r -= c[thid] * u_in[i+1];
+		} // if
+
+		if (blid > 0) {
+			r -= s_d[i] * u_in[i-system_size];
+		} // if
+
+		if (blid < num_lines-1) {
+			r -= n_d[i] * u_in[i+system_size];
+		} // if
+	} // if
+
+	d[thid] = r;
+
+	pcr_local(a, b, c, d, x, thid, items, iterations, NULL);
+
+	if (active) {
+		u_out[i] = u_in[i] + omega * x[thid];
+	} // if
+} // line_smooth
+
+/*
+ * Selective solves of a device-resident batch: copy the systems listed in
+ * active (one index per system) between the batch and a compact array of
+ * the active systems, one work-item per row.
+ */
+
+__kernel void gather_systems(__global const real_t * batch,
+	__global real_t * compact, __global const uint * active,
+	int system_size) {
+	const size_t row = get_global_id(0);
+	const size_t s = row / system_size;
+
+	compact[row] = batch[active[s] * (size_t)system_size +
+		(row - s * system_size)];
+} // gather_systems
+
+__kernel void scatter_systems(__global const real_t * compact,
+	__global real_t * batch, __global const uint * active,
+	int system_size) {
+	const size_t row = get_global_id(0);
+	const size_t s = row / system_size;
+
+	batch[active[s] * (size_t)system_size + (row - s * system_size)] =
+		compact[row];
+} // scatter_systems
+
 /*
  * Local Variables:
  * mode: c
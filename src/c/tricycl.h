@@ -16,6 +16,68 @@
 extern "C" {
 #endif
 
+/*----------------------------------------------------------------------------*
+ * Return codes.  Device failures are not reported: the solve falls back to
+ * the host unless TRICYCL_HOST_FALLBACK=0, in which case the OpenCL error
+ * code is returned.
+ *----------------------------------------------------------------------------*/
+
+#define TRICYCL_SUCCESS 0
+#define TRICYCL_INVALID_TOKEN -1001
+#define TRICYCL_INVALID_VALUE -1002
+#define TRICYCL_OUT_OF_HOST_MEMORY -1003
+
+/*----------------------------------------------------------------------------*
+ * Solve phases reported by tricycl_get_stats.
+ *----------------------------------------------------------------------------*/
+
+typedef enum {
+	TRICYCL_PHASE_INTERFACE = 0, /* host construction of interface system */
+	TRICYCL_PHASE_UPLOAD,        /* buffer creation and host-to-device copies */
+	TRICYCL_PHASE_INTERFACE_PCR, /* PCR solve of the interface system */
+	TRICYCL_PHASE_UNCOUPLE,      /* scatter of interface values */
+	TRICYCL_PHASE_PCR,           /* PCR solve of the sub-systems */
+	TRICYCL_PHASE_READBACK,      /* device-to-host copy of the solution */
+	TRICYCL_PHASE_HOST,          /* host Thomas solve */
+	TRICYCL_PHASE_RESIDUAL,      /* device residual norms */
+	TRICYCL_NUM_PHASES
+} tricycl_phase_t;
+
+typedef struct {
+	uint64_t calls;
+	double wall_seconds;   /* host time from enqueue to completion */
+	double device_seconds; /* event START to END, needs a profiling queue */
+} tricycl_phase_stats_t;
+
+typedef struct {
+	uint64_t solves;
+	uint64_t host_solves;
+	uint64_t device_failures; /* device solves that fell back to the host */
+	double wall_seconds;
+	tricycl_phase_stats_t phases[TRICYCL_NUM_PHASES];
+	uint64_t bytes_to_device;
+	uint64_t bytes_from_device;
+
+	/* parameters chosen for the most recent solve (sub_size 0: host) */
+	uint64_t system_size;
+	uint64_t num_systems;
+	uint64_t sub_size;
+	uint64_t sub_iterations;
+	uint64_t interface_size;
+	uint64_t interface_iterations;
+} tricycl_stats_t;
+
+/*----------------------------------------------------------------------------*
+ * Strided 2-D or 3-D grid for line solves along one axis.  Unused axes
+ * have dimension 1.  Strides are in elements.
+ *----------------------------------------------------------------------------*/
+
+typedef struct {
+	size_t dims[3];
+	size_t strides[3];
+	int32_t axis; /* 0, 1 or 2 */
+} tricycl_grid_t;
+
 size_t tricycl_init_sp(cl_device_id id, cl_context context,
 	cl_command_queue queue);
 
@@ -29,6 +91,17 @@ size_t tricycl_init_dp_ocl(void * instance);
 /*!
 \page tricycl_solve_sp
 
+Solves may be called concurrently from several host threads with the same
+token.  The thread that called init enqueues on the application queue;
+every other thread gets its own queue (with the same properties) and its
+own kernel objects on first use.
+
+Shapes without a tuning entry are planned from a cost model calibrated at
+init (disable with TRICYCL_PLANNER=0): a direct device solve, a
+partitioned device solve, or a serial Thomas solve on the host for tiny
+or unsupported shapes.  Returns TRICYCL_SUCCESS or one of the error codes
+above.
+
 \par Interface:
  */
 int32_t tricycl_solve_sp(size_t token, size_t system_size, size_t num_systems,
@@ -42,6 +115,367 @@ int32_t tricycl_solve_sp(size_t token, size_t system_size, size_t num_systems,
 int32_t tricycl_solve_dp(size_t token, size_t system_size, size_t num_systems,
 	double * a, double * b, double * c, double * d, double * x);
 
+/*!
+\page tricycl_solve_inplace_sp
+
+Low-footprint solve: the solution overwrites d, and a, b and c may be
+overwritten as well.  The device keeps four full-size arrays instead of
+five and reads the solution back from the d buffer.  Equivalent to
+tricycl_solve_sp with x = d.
+
+\par Interface:
+ */
+int32_t tricycl_solve_inplace_sp(size_t token, size_t system_size,
+	size_t num_systems, float * a, float * b, float * c, float * d);
+
+/*!
+\page tricycl_solve_inplace_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_inplace_dp(size_t token, size_t system_size,
+	size_t num_systems, double * a, double * b, double * c, double * d);
+
+/*!
+\page tricycl_solve_truncated_sp
+
+Approximate solve for strongly diagonally dominant systems (truncated
+SPIKE).  When the system is partitioned, the interface values are taken
+from the neighboring partitions only, which removes the interface solve
+and the uncouple kernel.  The truncation is used only if every row is
+diagonally dominant and the bound rho on the relative error
+(max |x - x_exact| <= rho max |x_exact|) is at most tolerance; otherwise
+the solve is exact.  The bound used is returned in bound (0 for exact).
+
+\par Interface:
+ */
+int32_t tricycl_solve_truncated_sp(size_t token, size_t system_size,
+	size_t num_systems, float * a, float * b, float * c, float * d,
+	float * x, double tolerance, double * bound);
+
+/*!
+\page tricycl_solve_truncated_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_truncated_dp(size_t token, size_t system_size,
+	size_t num_systems, double * a, double * b, double * c, double * d,
+	double * x, double tolerance, double * bound);
+
+/*!
+\page tricycl_solve_residual_sp
+
+Solve and compute the residual d - A x of every system on the device,
+after the PCR solve, so convergence can be monitored without reading x
+back.  norms must hold 2*num_systems+2 values: the L2 and L-infinity
+norms of system s are norms[2*s] and norms[2*s+1], and those of the
+whole batch follow at norms[2*num_systems] and norms[2*num_systems+1].
+x may be NULL, in which case the solution is not read back; it must not
+be d.  Host solves compute the norms on the host.
+
+\par Interface:
+ */
+int32_t tricycl_solve_residual_sp(size_t token, size_t system_size,
+	size_t num_systems, float * a, float * b, float * c, float * d,
+	float * x, float * norms);
+
+/*!
+\page tricycl_solve_residual_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_residual_dp(size_t token, size_t system_size,
+	size_t num_systems, double * a, double * b, double * c, double * d,
+	double * x, double * norms);
+
+/*!
+\page tricycl_solve_grid_sp
+
+Solve every line along grid->axis of a strided grid, reading a, b, c and
+d and writing x in the caller's layout (e.g. the y or z direction of an
+ADI sweep), so no gather or scatter is needed.  The other two axes form
+the batch.  All five arrays share the grid layout; elements not on the
+grid are left unchanged, and a of the first and c of the last row of
+each line are ignored.  Lines that fit in one work group (padded to a
+power of two) are solved on the device, longer lines on the host.
+
+\par Interface:
+ */
+int32_t tricycl_solve_grid_sp(size_t token, const tricycl_grid_t * grid,
+	float * a, float * b, float * c, float * d, float * x);
+
+/*!
+\page tricycl_solve_grid_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_grid_dp(size_t token, const tricycl_grid_t * grid,
+	double * a, double * b, double * c, double * d, double * x);
+
+/*!
+\page tricycl_solve_ragged_sp
+
+Solve num_systems systems of different sizes in one call.  The systems
+are stored back to back in a, b, c, d and x, and system s occupies rows
+offsets[s] to offsets[s+1]-1 (CSR offsets: num_systems+1 entries,
+offsets[0] zero, non-decreasing; empty systems are allowed).  a of the
+first and c of the last row of each system are ignored.  The systems are
+binned by size and every bin is solved between a single upload and a
+single readback.
+
+\par Interface:
+ */
+int32_t tricycl_solve_ragged_sp(size_t token, size_t num_systems,
+	const size_t * offsets, float * a, float * b, float * c, float * d,
+	float * x);
+
+/*!
+\page tricycl_solve_ragged_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_ragged_dp(size_t token, size_t num_systems,
+	const size_t * offsets, double * a, double * b, double * c, double * d,
+	double * x);
+
+/*!
+\page tricycl_solve_symmetric_sp
+
+Solve symmetric systems given the diagonal b and the off-diagonal e,
+where e[i] couples rows i and i+1 of a system (e of the last row of each
+system is ignored).  Only three coefficient arrays are moved to the
+device and the kernels keep four values per row in local memory, so
+larger sub-systems fit than for tricycl_solve_sp.  Shapes the symmetric
+kernels cannot handle are solved as general systems.
+
+\par Interface:
+ */
+int32_t tricycl_solve_symmetric_sp(size_t token, size_t system_size,
+	size_t num_systems, float * b, float * e, float * d, float * x);
+
+/*!
+\page tricycl_solve_symmetric_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_symmetric_dp(size_t token, size_t system_size,
+	size_t num_systems, double * b, double * e, double * d, double * x);
+
+/*!
+\page tricycl_solve_packed_sp
+
+Solve systems whose rows are stored as structs {a, b, c, d}: rows holds
+4*system_size*num_systems values, row i of system s at
+rows[4*(s*system_size + i)].  Systems that fit in one work group are
+uploaded as a single buffer and solved directly from it; other shapes
+are unpacked on the host and solved as with tricycl_solve_sp.
+
+\par Interface:
+ */
+int32_t tricycl_solve_packed_sp(size_t token, size_t system_size,
+	size_t num_systems, const float * rows, float * x);
+
+/*!
+\page tricycl_solve_packed_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_packed_dp(size_t token, size_t system_size,
+	size_t num_systems, const double * rows, double * x);
+
+/*!
+\page tricycl_smooth_sp
+
+Line smoother for multigrid.  The operator A couples row i of line l
+(num_lines lines of system_size rows, stored like the systems of
+tricycl_solve_sp) to rows i-1 and i+1 of the same line through a and c,
+to itself through b, and to row i of lines l-1 and l+1 through s and n.
+Each of the sweeps damped line-Jacobi sweeps computes r = f - A u,
+solves the tridiagonal (a, b, c) system of every line for x and sets
+u = u + omega x.  s of the first line, n of the last line, and a of the
+first and c of the last row of each line are ignored.
+
+Lines that fit in one work group (padded to a power of two) are smoothed
+on the device, where all sweeps run between a single upload and a single
+readback of u; longer lines are smoothed on the host.
+
+\par Interface:
+ */
+int32_t tricycl_smooth_sp(size_t token, size_t system_size,
+	size_t num_lines, const float * a, const float * b, const float * c,
+	const float * s, const float * n, const float * f, float * u,
+	float omega, size_t sweeps);
+
+/*!
+\page tricycl_smooth_dp
+
+\par Interface:
+ */
+int32_t tricycl_smooth_dp(size_t token, size_t system_size,
+	size_t num_lines, const double * a, const double * b, const double * c,
+	const double * s, const double * n, const double * f, double * u,
+	double omega, size_t sweeps);
+
+/*!
+\page tricycl_batch_create_sp
+
+Selective solves for batches in which only a few systems change between
+calls.  tricycl_batch_create_sp uploads a, b, c and d for num_systems
+systems once and returns a handle in batch; the device copy persists
+until tricycl_batch_destroy_sp.
+
+tricycl_batch_update_sp replaces the systems listed in active (num_active
+distinct indices less than num_systems): a, b, c and d hold just those
+systems, in the order of active, and any of them may be NULL to keep the
+resident values (e.g. a new right-hand side only).
+
+tricycl_batch_solve_sp solves the systems listed in active against the
+resident batch and writes their solutions to x, again in the order of
+active.  The systems are gathered on the device, so the transfers and the
+device work scale with num_active, not with the batch.  Systems that fit
+in one work group are solved directly; longer systems are read back and
+solved as with tricycl_solve_sp.
+
+Operations on one batch are serialized.  Returns TRICYCL_SUCCESS or one
+of the error codes above (TRICYCL_INVALID_VALUE for an unknown batch).
+
+\par Interface:
+ */
+int32_t tricycl_batch_create_sp(size_t token, size_t system_size,
+	size_t num_systems, const float * a, const float * b, const float * c,
+	const float * d, size_t * batch);
+
+int32_t tricycl_batch_update_sp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, const float * a,
+	const float * b, const float * c, const float * d);
+
+int32_t tricycl_batch_solve_sp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, float * x);
+
+int32_t tricycl_batch_destroy_sp(size_t token, size_t batch);
+
+/*!
+\page tricycl_batch_create_dp
+
+See \ref tricycl_batch_create_sp.
+
+\par Interface:
+ */
+int32_t tricycl_batch_create_dp(size_t token, size_t system_size,
+	size_t num_systems, const double * a, const double * b,
+	const double * c, const double * d, size_t * batch);
+
+int32_t tricycl_batch_update_dp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, const double * a,
+	const double * b, const double * c, const double * d);
+
+int32_t tricycl_batch_solve_dp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, double * x);
+
+int32_t tricycl_batch_destroy_dp(size_t token, size_t batch);
+
+/*!
+\page tricycl_batch_begin_sp
+
+Deferred solves for callers that issue many small solves.  After
+tricycl_batch_begin_sp, tricycl_batch_add_sp only records a solve (with
+the arguments of tricycl_solve_sp) for the calling thread; the arrays
+must stay valid, and x is not written, until tricycl_batch_flush_sp.
+The flush concatenates the recorded solves of each system size and
+solves them together, with one upload and one launch sequence per size,
+then copies each solution to its x.
+
+Recording is per thread and per token.  tricycl_batch_add_sp and
+tricycl_batch_flush_sp return TRICYCL_INVALID_VALUE without a preceding
+tricycl_batch_begin_sp; the flush returns the first error of any size.
+
+\par Interface:
+ */
+int32_t tricycl_batch_begin_sp(size_t token);
+
+int32_t tricycl_batch_add_sp(size_t token, size_t system_size,
+	size_t num_systems, const float * a, const float * b, const float * c,
+	const float * d, float * x);
+
+int32_t tricycl_batch_flush_sp(size_t token);
+
+/*!
+\page tricycl_batch_begin_dp
+
+See \ref tricycl_batch_begin_sp.
+
+\par Interface:
+ */
+int32_t tricycl_batch_begin_dp(size_t token);
+
+int32_t tricycl_batch_add_dp(size_t token, size_t system_size,
+	size_t num_systems, const double * a, const double * b,
+	const double * c, const double * d, double * x);
+
+int32_t tricycl_batch_flush_dp(size_t token);
+
+/*!
+\page tricycl_tune_sp
+
+Sweep the solver parameters for one problem shape and store the fastest
+in the tuning file (TRICYCL_TUNING_FILE, default tricycl_tuning.dat).
+Later solves with the same shape on the same device use the stored
+parameters.  Setting TRICYCL_AUTOTUNE makes tricycl_solve_sp tune
+unknown shapes automatically.  Returns TRICYCL_SUCCESS or one of the
+error codes above.
+
+\par Interface:
+ */
+int32_t tricycl_tune_sp(size_t token, size_t system_size, size_t num_systems);
+
+/*!
+\page tricycl_tune_dp
+
+See \ref tricycl_tune_sp.
+
+\par Interface:
+ */
+int32_t tricycl_tune_dp(size_t token, size_t system_size, size_t num_systems);
+
+/*!
+\page tricycl_get_stats
+
+Copy the accumulated timing and transfer statistics of all solves (both
+precisions) since the last tricycl_reset_stats.  Phase wall times are
+measured on the host from enqueue to completion, so the upload and the
+interface solve overlap.  Device times are only available when the
+command queue was created with CL_QUEUE_PROFILING_ENABLE.
+
+Setting TRICYCL_STATS prints a summary at exit; setting TRICYCL_TRACE to
+a file name writes a Chrome trace (chrome://tracing) at exit.
+
+\par Interface:
+ */
+void tricycl_get_stats(tricycl_stats_t * stats);
+
+/*!
+\page tricycl_reset_stats
+
+\par Interface:
+ */
+void tricycl_reset_stats(void);
+
+/*!
+\page tricycl_write_trace
+
+Write the recorded phases as Chrome trace JSON.  Returns 0 on success.
+
+\par Interface:
+ */
+int32_t tricycl_write_trace(const char * filename);
+
+/*!
+\page tricycl_phase_name
+
+\par Interface:
+ */
+const char * tricycl_phase_name(int32_t phase);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -6,14 +6,32 @@
 #define tricycl_hh
 
 #include <vector>
+#include <string>
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include <new>
+#include <map>
+#include <atomic>
+#include <mutex>
+
+#if defined(ENABLE_TRICYCL_MPI)
+#include <mpi.h>
+#endif
 
 #define _include_tricycl_h
 
 #include <tricycl_local.h>
 #include <tricycl_strings.h>
 #include <tricycl_utils.h>
+#include <tricycl_tuning.hh>
+#include <tricycl_jit.hh>
+#include <tricycl_stats.hh>
 
 /*----------------------------------------------------------------------------*
  * Utility for selecting correct compiler options.
@@ -23,14 +41,43 @@ template<typename T> struct TypeToOpt {};
 
 template<> struct TypeToOpt<float> {
 	inline static const char * option_string() {
-		return "-Dreal_t=float";
+		return "-Dreal_t=float -Dreal4_t=float4";
 	} // option_string
+
+	inline static const char * precision_string() {
+		return "sp";
+	} // precision_string
+
+	inline static bool native_divide() {
+		return true;
+	} // native_divide
+
+#if defined(ENABLE_TRICYCL_MPI)
+	inline static MPI_Datatype mpi_type() {
+		return MPI_FLOAT;
+	} // mpi_type
+#endif
 }; // struct TypeToOpt
 
 template<> struct TypeToOpt<double> {
 	inline static const char * option_string() {
-		return "-Dreal_t=double";
+		return "-Dreal_t=double -Dreal4_t=double4";
 	} // option_string
+
+	inline static const char * precision_string() {
+		return "dp";
+	} // precision_string
+
+	// native_divide is only defined for single precision
+	inline static bool native_divide() {
+		return false;
+	} // native_divide
+
+#if defined(ENABLE_TRICYCL_MPI)
+	inline static MPI_Datatype mpi_type() {
+		return MPI_DOUBLE;
+	} // mpi_type
+#endif
 }; // struct TypeToOpt
 
 /*----------------------------------------------------------------------------*
@@ -58,23 +105,6 @@ public:
 
 	typedef size_t data_token_t;
 
-	/*-------------------------------------------------------------------------*
-	 * OpenCL things that need to be stored.
-	 *-------------------------------------------------------------------------*/
-
-	struct solver_data_t {
-		cl_device_id id;
-		cl_context context;	
-		cl_command_queue queue;
-		cl_program program;
-		cl_kernel pcr_kernel;
-		cl_kernel copy_kernel;
-
-		solver_data_t(cl_device_id & _id, cl_context & _context,
-			cl_command_queue & _queue)
-			: id(_id), context(_context), queue(_queue) {}
-	}; // struct solver_data_t
-
 	/*-------------------------------------------------------------------------*
 	 * Interface system data structure.
 	 *-------------------------------------------------------------------------*/
@@ -149,12 +179,135 @@ public:
 		cl_command_queue & queue);
 
 	/*-------------------------------------------------------------------------*
-	 * Solve method.
+	 * Solve method.  x may be d, in which case the device solution is
+	 * written over the right-hand side buffer (one less full-size buffer).
 	 *-------------------------------------------------------------------------*/
 
 	int32_t solve(data_token_t token, size_t system_size, size_t num_systems,
 		real_t * a, real_t * b, real_t * c, real_t * d, real_t * x);
 
+	/*-------------------------------------------------------------------------*
+	 * Solve with truncated SPIKE interfaces when the relative error bound
+	 * is at most tolerance; the bound used (0 for an exact solve) is
+	 * returned in bound.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_truncated(data_token_t token, size_t system_size,
+		size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+		real_t * x, double tolerance, double * bound);
+
+	/*-------------------------------------------------------------------------*
+	 * Solve and compute the residual norms on the device: norms[2*s] and
+	 * norms[2*s+1] are the L2 and L-infinity norms of d - A x for system s,
+	 * and norms[2*num_systems] and norms[2*num_systems+1] those of the whole
+	 * batch.  The solution is not read back if x is NULL.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_residual(data_token_t token, size_t system_size,
+		size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+		real_t * x, real_t * norms);
+
+	/*-------------------------------------------------------------------------*
+	 * Solve every line along one axis of a strided grid in place in the
+	 * caller's layout.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_grid(data_token_t token, const tricycl_grid_t & grid,
+		real_t * a, real_t * b, real_t * c, real_t * d, real_t * x);
+
+	/*-------------------------------------------------------------------------*
+	 * Solve systems of different sizes in one call.  System s occupies rows
+	 * offsets[s] to offsets[s+1]-1 of each array, and offsets[0] is zero.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_ragged(data_token_t token, size_t num_systems,
+		const size_t * offsets, real_t * a, real_t * b, real_t * c,
+		real_t * d, real_t * x);
+
+	/*-------------------------------------------------------------------------*
+	 * Damped line-Jacobi smoothing for multigrid: each sweep computes
+	 * r = f - A u, solves T x = r for every line, with T the tridiagonal
+	 * (a, b, c) part of A, and sets u += omega x.  s and n couple each line
+	 * to the previous and the next one.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t smooth(data_token_t token, size_t system_size, size_t num_lines,
+		const real_t * a, const real_t * b, const real_t * c,
+		const real_t * s, const real_t * n, const real_t * f, real_t * u,
+		real_t omega, size_t sweeps);
+
+	/*-------------------------------------------------------------------------*
+	 * Solve symmetric systems from the diagonal b and the off-diagonal e
+	 * (e[i] couples rows i and i+1, a[i+1] == c[i] == e[i]).
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_symmetric(data_token_t token, size_t system_size,
+		size_t num_systems, real_t * b, real_t * e, real_t * d, real_t * x);
+
+	/*-------------------------------------------------------------------------*
+	 * Solve systems with rows packed as {a, b, c, d} (4*system_size*
+	 * num_systems values).
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_packed(data_token_t token, size_t system_size,
+		size_t num_systems, const real_t * rows, real_t * x);
+
+	/*-------------------------------------------------------------------------*
+	 * Device-resident batches for selective solves.  batch_update replaces
+	 * and batch_solve solves only the systems listed in active, so the
+	 * transfers and the device work scale with the number of active
+	 * systems rather than with the batch.
+	 *-------------------------------------------------------------------------*/
+
+	typedef size_t batch_token_t;
+
+	int32_t batch_create(data_token_t token, size_t system_size,
+		size_t num_systems, const real_t * a, const real_t * b,
+		const real_t * c, const real_t * d, batch_token_t & batch);
+
+	int32_t batch_update(data_token_t token, batch_token_t batch,
+		size_t num_active, const uint32_t * active, const real_t * a,
+		const real_t * b, const real_t * c, const real_t * d);
+
+	int32_t batch_solve(data_token_t token, batch_token_t batch,
+		size_t num_active, const uint32_t * active, real_t * x);
+
+	int32_t batch_destroy(data_token_t token, batch_token_t batch);
+
+	/*-------------------------------------------------------------------------*
+	 * Deferred solves.  Between batch_begin and batch_flush, batch_add only
+	 * records a solve for the calling thread; batch_flush concatenates the
+	 * recorded systems of each system size, solves them with one call to
+	 * solve and copies the solutions to each caller's x.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t batch_begin(data_token_t token);
+
+	int32_t batch_add(data_token_t token, size_t system_size,
+		size_t num_systems, const real_t * a, const real_t * b,
+		const real_t * c, const real_t * d, real_t * x);
+
+	int32_t batch_flush(data_token_t token);
+
+#if defined(ENABLE_TRICYCL_MPI)
+	/*-------------------------------------------------------------------------*
+	 * Solve systems whose rows are split across the ranks of comm, in rank
+	 * order.  Collective over comm.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_mpi(data_token_t token, MPI_Comm comm, size_t local_size,
+		size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+		real_t * x);
+#endif
+
+	/*-------------------------------------------------------------------------*
+	 * Sweep the solver parameters for one problem shape, record the fastest
+	 * in the tuning database and return it in tuning.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t tune(data_token_t token, size_t system_size, size_t num_systems,
+		tuning_t & tuning);
+
 private:
 
 	/*-------------------------------------------------------------------------*
@@ -191,391 +344,4854 @@ private:
 	}; // struct kernel_work_group_info
 
 	/*-------------------------------------------------------------------------*
-	 * Hide these.
+	 * OpenCL things that need to be stored.
 	 *-------------------------------------------------------------------------*/
 
-	TriCyCL() {}
-	TriCyCL(const TriCyCL &) {}
-	TriCyCL & operator = (const TriCyCL &);
+	struct solver_data_t {
+		cl_device_id id;
+		cl_context context;	
+		cl_command_queue queue;
+		cl_command_queue_properties queue_properties;
+		cl_program program;
+		cl_kernel pcr_kernel;
 
-	~TriCyCL() {}
+		// the application queue is used by the thread that called init
+		std::thread::id init_thread;
 
-	/*-------------------------------------------------------------------------*
-	 * Create interface systems.
-	 *-------------------------------------------------------------------------*/
+		// built on first use (see native_program)
+		cl_program native_program;
+		std::once_flag native_once;
 
-	interface_t * create_interface_system(size_t system_size,
-		size_t num_systems, size_t sub_size, size_t sub_systems,
-		real_t * a, real_t * b, real_t * c, real_t * d);
+		// shape-specialized PCR programs (NULL if disabled)
+		JITCache * jit_cache;
 
-	void create_buffer(cl_context & context, cl_mem_flags flags,
-		size_t bytes, cl_mem & d_p, void * h_p);
+		// strategy selection for untuned shapes
+		cost_model_t cost_model;
+		bool planner;
+		bool host_fallback;
+
+		device_info_t device_info;
+		kernel_work_group_info_t kernel_info;
+		std::string device_key;
+
+		solver_data_t(cl_device_id & _id, cl_context & _context,
+			cl_command_queue & _queue)
+			: id(_id), context(_context), queue(_queue),
+			queue_properties(0), init_thread(std::this_thread::get_id()),
+			native_program(NULL), jit_cache(NULL), planner(true),
+			host_fallback(true) {}
+	}; // struct solver_data_t
 
 	/*-------------------------------------------------------------------------*
-	 * Get device info.
+	 * OpenCL objects created by one solve, released on every return path.
 	 *-------------------------------------------------------------------------*/
 
-	device_info_t get_device_info(cl_device_id & id);
+	struct solve_resources_t {
+		static const size_t num_mem = 19;
+		static const size_t num_events = 14;
+
+		cl_mem mem[num_mem];
+		cl_event events[num_events];
+		std::vector<cl_event> level_events;
+		interface_t * interface;
+
+		solve_resources_t()
+			: interface(nullptr) {
+			for(size_t i(0); i<num_mem; ++i) { mem[i] = NULL; }
+			for(size_t i(0); i<num_events; ++i) { events[i] = NULL; }
+		} // solve_resources_t
+
+		~solve_resources_t() {
+			for(size_t i(0); i<num_mem; ++i) {
+				if(mem[i] != NULL) { clReleaseMemObject(mem[i]); }
+			} // for
+
+			for(size_t i(0); i<num_events; ++i) {
+				if(events[i] != NULL) { clReleaseEvent(events[i]); }
+			} // for
+
+			for(size_t i(0); i<level_events.size(); ++i) {
+				clReleaseEvent(level_events[i]);
+			} // for
+
+			delete interface;
+		} // ~solve_resources_t
+	}; // struct solve_resources_t
 
 	/*-------------------------------------------------------------------------*
-	 * Get kernel info.
+	 * Solve recorded by batch_add.
 	 *-------------------------------------------------------------------------*/
 
-	kernel_work_group_info_t get_kernel_work_group_info(cl_device_id & id,
-		device_info_t & device_info, cl_kernel & kernel);
+	struct deferred_t {
+		size_t system_size;
+		size_t num_systems;
+		const real_t * a;
+		const real_t * b;
+		const real_t * c;
+		const real_t * d;
+		real_t * x;
+	}; // struct deferred_t
 
 	/*-------------------------------------------------------------------------*
-	 * Iterations for cyclic reduction.
+	 * Per-thread OpenCL state for one token.
+	 *
+	 * Kernel arguments are stored in the kernel object, so every host thread
+	 * sets arguments on its own kernels, and enqueues on its own queue so
+	 * that solves from different threads do not serialize.
 	 *-------------------------------------------------------------------------*/
 
-	size_t iterations(size_t elements) {
-		size_t ita(elements/2);
-		size_t cnt(0);
-		do { ++cnt; ita/=2; } while(ita>1);
-		return cnt;
-	} // iterations
+	struct thread_data_t {
+		cl_command_queue queue;
+		bool owns_queue;
+		cl_kernel copy_kernel;
+		cl_kernel strided_kernel;
+		cl_kernel truncated_kernel;
+		cl_kernel global_kernel;
+		cl_kernel rows_kernel;
+		cl_kernel fused_kernel;
+		cl_kernel ragged_kernel;
+		cl_kernel smooth_kernel;
+		cl_kernel symmetric_kernel;
+		cl_kernel symmetric_copy_kernel;
+		cl_kernel packed_kernel;
+		cl_kernel thomas_kernel;
+		cl_kernel gather_kernel;
+		cl_kernel scatter_kernel;
+		cl_kernel residual_kernel;
+
+		// PCR kernels by program (generic, native-divide or specialized)
+		// and variant
+		std::map<std::pair<cl_program, pcr_variant_t>, cl_kernel> pcr_kernels;
+
+		// solves recorded since batch_begin
+		bool deferring;
+		std::vector<deferred_t> deferred;
+
+		thread_data_t()
+			: queue(NULL), owns_queue(false), copy_kernel(NULL),
+			strided_kernel(NULL), truncated_kernel(NULL),
+			global_kernel(NULL), rows_kernel(NULL), fused_kernel(NULL),
+			ragged_kernel(NULL), smooth_kernel(NULL), symmetric_kernel(NULL),
+			symmetric_copy_kernel(NULL), packed_kernel(NULL),
+			thomas_kernel(NULL), gather_kernel(NULL), scatter_kernel(NULL),
+			residual_kernel(NULL),
+			deferring(false) {}
+
+		~thread_data_t() {
+			clear();
+
+			if(copy_kernel != NULL) {
+				clReleaseKernel(copy_kernel);
+			} // if
+
+			if(strided_kernel != NULL) {
+				clReleaseKernel(strided_kernel);
+			} // if
+
+			if(truncated_kernel != NULL) {
+				clReleaseKernel(truncated_kernel);
+			} // if
+
+			if(global_kernel != NULL) {
+				clReleaseKernel(global_kernel);
+			} // if
+
+			if(rows_kernel != NULL) {
+				clReleaseKernel(rows_kernel);
+			} // if
+
+			if(fused_kernel != NULL) {
+				clReleaseKernel(fused_kernel);
+			} // if
+
+			if(ragged_kernel != NULL) {
+				clReleaseKernel(ragged_kernel);
+			} // if
+
+			if(smooth_kernel != NULL) {
+				clReleaseKernel(smooth_kernel);
+			} // if
+
+			if(symmetric_kernel != NULL) {
+				clReleaseKernel(symmetric_kernel);
+			} // if
+
+			if(symmetric_copy_kernel != NULL) {
+				clReleaseKernel(symmetric_copy_kernel);
+			} // if
+
+			if(packed_kernel != NULL) {
+				clReleaseKernel(packed_kernel);
+			} // if
+
+			if(thomas_kernel != NULL) {
+				clReleaseKernel(thomas_kernel);
+			} // if
+
+			if(gather_kernel != NULL) {
+				clReleaseKernel(gather_kernel);
+			} // if
+
+			if(scatter_kernel != NULL) {
+				clReleaseKernel(scatter_kernel);
+			} // if
+
+			if(residual_kernel != NULL) {
+				clReleaseKernel(residual_kernel);
+			} // if
+
+			if(owns_queue) {
+				clReleaseCommandQueue(queue);
+			} // if
+		} // ~thread_data_t
+
+		void clear() {
+			for(typename std::map<std::pair<cl_program, pcr_variant_t>,
+				cl_kernel>::iterator ita = pcr_kernels.begin();
+				ita != pcr_kernels.end(); ++ita) {
+				clReleaseKernel(ita->second);
+			} // for
+
+			pcr_kernels.clear();
+		} // clear
+
+		// the kernels keep evicted specializations alive, so start over
+		// once they could outnumber the live ones; only called before a
+		// solve takes any kernel from the cache
+		void trim() {
+			if(pcr_kernels.size() > 64) {
+				clear();
+			} // if
+		} // trim
+	}; // struct thread_data_t
+
+	struct thread_data_list_t {
+		std::vector<thread_data_t *> data;
+
+		~thread_data_list_t() {
+			for(size_t i(0); i<data.size(); ++i) {
+				delete data[i];
+			} // for
+		} // ~thread_data_list_t
+	}; // struct thread_data_list_t
 
 	/*-------------------------------------------------------------------------*
-	 * Private data members.
+	 * Hide these.
 	 *-------------------------------------------------------------------------*/
 
-	std::vector<solver_data_t> data_;
+	TriCyCL()
+		: num_tokens_(0), next_batch_(0) {
+		for(size_t i(0); i<max_tokens; ++i) {
+			data_[i] = NULL;
+		} // for
+	} // TriCyCL
 
-}; // class TriCyCL
+	TriCyCL(const TriCyCL &) {}
+	TriCyCL & operator = (const TriCyCL &);
 
-/*----------------------------------------------------------------------------*
- * Init
- *----------------------------------------------------------------------------*/
+	~TriCyCL() {}
 
-template<typename real_t>
-typename TriCyCL<real_t>::data_token_t
-TriCyCL<real_t>::init(cl_device_id & id, cl_context & context,
-	cl_command_queue & queue) {
-	int32_t ierr = 0;
-	solver_data_t _solver_data(id, context, queue);
+	/*-------------------------------------------------------------------------*
+	 * Build the solver program with the given options, NULL on failure.
+	 *-------------------------------------------------------------------------*/
 
-	// create program object
-	_solver_data.program = clCreateProgramWithSource(_solver_data.context,
-		1, (const char **)&tricycl_PPSTR, NULL, &ierr);
+	cl_program build_program(solver_data_t & solver_data,
+		const std::string & compile_options);
 
-	if(ierr != CL_SUCCESS) {
-		std::cerr << "clCreateProgramWithSource failed with " <<
-			ierr << std::endl;
-		std::exit(1);
-	} // if
+	/*-------------------------------------------------------------------------*
+	 * Device-resident batch, a..d in mem[0..3].  Operations on one batch
+	 * are serialized by its mutex.
+	 *-------------------------------------------------------------------------*/
 
-	// compile the program
-	const char * compile_options = TypeToOpt<real_t>::option_string();
-	ierr = clBuildProgram(_solver_data.program, 1, &_solver_data.id,
-		compile_options, NULL, NULL);
+	struct batch_t {
+		data_token_t token;
+		cl_context context;
+		size_t system_size;
+		size_t num_systems;
+		cl_mem mem[4];
+		std::mutex mutex;
+
+		batch_t(data_token_t _token, cl_context _context,
+			size_t _system_size, size_t _num_systems)
+			: token(_token), context(_context), system_size(_system_size),
+			num_systems(_num_systems) {
+			for(size_t i(0); i<4; ++i) { mem[i] = NULL; }
+		} // batch_t
+
+		~batch_t() {
+			for(size_t i(0); i<4; ++i) {
+				if(mem[i] != NULL) { clReleaseMemObject(mem[i]); }
+			} // for
+		} // ~batch_t
+	}; // struct batch_t
 
-	// output something useful if the build fails
-	if(ierr == CL_BUILD_PROGRAM_FAILURE) {
-		char buffer[256*1024];
-		size_t length;
+	/*-------------------------------------------------------------------------*
+	 * Find a batch and lock its mutex into lock.  The mutex is taken
+	 * while batch_mutex_ is held, so batch_destroy cannot free the batch
+	 * between the lookup and the lock.
+	 *-------------------------------------------------------------------------*/
 
-		clGetProgramBuildInfo(_solver_data.program, _solver_data.id,
-			CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &length);
+	batch_t * find_batch(data_token_t token, batch_token_t batch,
+		std::unique_lock<std::mutex> & lock);
 
-		std::cerr << "clBuildProgram failed:" << std::endl <<
-			buffer << std::endl << compile_options << std::endl;
-		std::exit(1);
-	} // if
+	/*-------------------------------------------------------------------------*
+	 * Check an active list against a batch and upload it to d_active
+	 * (nothing is uploaded for an empty list).
+	 *-------------------------------------------------------------------------*/
 
-	// create solver kernel
-	_solver_data.pcr_kernel = clCreateKernel(_solver_data.program,
-		"pcr_branch_free_kernel", &ierr);
+	int32_t check_active(batch_t & batch, size_t num_active,
+		const uint32_t * active, cl_mem & d_active);
 
-	// create copy kernel
-	_solver_data.copy_kernel = clCreateKernel(_solver_data.program,
-		"uncouple", &ierr);
+	int32_t enqueue_batch_copy(cl_kernel kernel, cl_command_queue queue,
+		cl_mem from, cl_mem to, cl_mem d_active, size_t system_size,
+		size_t num_active, cl_event * event);
 
-	if(ierr != CL_SUCCESS) {
-		std::cerr << "clCreateKernel failed with " << ierr << std::endl;
-		std::exit(1);
-	} // if
+	/*-------------------------------------------------------------------------*
+	 * Token lookup, safe to call concurrently with init.
+	 *-------------------------------------------------------------------------*/
 
-	data_.push_back(_solver_data);
+	solver_data_t & data(data_token_t token) {
+		return *data_[token].load(std::memory_order_acquire);
+	} // data
 
-	return data_.size()-1;
-} // TriCyCL<>::init
+	/*-------------------------------------------------------------------------*
+	 * Kernels and queue of the calling thread.
+	 *-------------------------------------------------------------------------*/
 
-/*----------------------------------------------------------------------------*
- * Solve.
- *----------------------------------------------------------------------------*/
+	thread_data_t * thread_data(data_token_t token);
 
-template<typename real_t>
-int32_t
-TriCyCL<real_t>::solve(data_token_t token, size_t system_size,
-	size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
-	real_t * x) {
-	CALLER_SELF
-	int32_t ierr = 0;
+	cl_kernel thread_pcr_kernel(data_token_t token, cl_program program,
+		pcr_variant_t variant);
 
-	cl_device_id device_id = data_[token].id;
-	cl_kernel pcr_kernel = data_[token].pcr_kernel;
-	cl_kernel copy_kernel = data_[token].copy_kernel;
-	cl_context context = data_[token].context;
-	cl_command_queue queue = data_[token].queue;
+	static const char * pcr_kernel_name(pcr_variant_t variant) {
+		return variant == pcr_adaptive ? "pcr_adaptive_kernel" :
+			"pcr_branch_free_kernel";
+	} // pcr_kernel_name
 
 	/*-------------------------------------------------------------------------*
-	 * Get device and kernel information.
+	 * PCR program compiled with -DNATIVE_DIVIDE, NULL if the build failed.
 	 *-------------------------------------------------------------------------*/
-	device_info_t device_info = get_device_info(device_id);
-	kernel_work_group_info_t kernel_info =
-		get_kernel_work_group_info(device_id, device_info, pcr_kernel);
 
-	// FIXME: Testing
-//kernel_info.work_group_size = 32;
+	cl_program native_program(data_token_t token);
 
 	/*-------------------------------------------------------------------------*
-	 * Sub-system calculations.
+	 * PCR kernel for one system size: the specialized kernel once it has been
+	 * built, otherwise the generic kernel.  NULL if no kernel is available.
 	 *-------------------------------------------------------------------------*/
-#define MIN(x,y) (x) < (y) ? (x) : (y)
-	size_t places = log2(kernel_info.work_group_size);
-	kernel_info.work_group_size = 1<<places;
-	// FIXME: Testing
-	size_t work_group_size = MIN(kernel_info.work_group_size, 4096);
-	size_t sub_size(work_group_size);
-	size_t sub_local_memory((sub_size+1)*5*sizeof(real_t));
-	size_t sub_systems(0);
-#undef MIN
-
-	if(system_size > work_group_size) {
-		while((system_size%sub_size != 0 ||
-			sub_local_memory > device_info.local_mem_size) && sub_size > 1) {
-			sub_size /= 2;
-			sub_local_memory = (sub_size+1)*5*sizeof(real_t);
-		} // while
 
-		if(sub_size == 1) {
-			message("System size must be evenly divisible by "
-				"a valid work group size");
-			std::exit(1);
-		} // if
+	cl_kernel select_pcr_kernel(data_token_t token, size_t system_size,
+		bool native_divide, pcr_variant_t variant);
 
-		sub_systems = system_size/sub_size;
-	} // if
+	void build_specialization(solver_data_t & solver_data,
+		JITCache::entry_t * entry);
 
-// FIXME: Testing
-//message("sub_size: %d\n", (int)sub_size);
+	void wait_for_specializations(data_token_t token);
 
 	/*-------------------------------------------------------------------------*
-	 * Setup interface system.
+	 * Solver parameters.
 	 *-------------------------------------------------------------------------*/
-	size_t interface_size(2*sub_systems*num_systems);
-	size_t interface_local_memory((interface_size+1)*5*sizeof(real_t));
-	size_t interface_iterations(iterations(interface_size));
-	size_t interface_systems(1);
 
-	if(interface_size > kernel_info.work_group_size ||
-		interface_local_memory > device_info.local_mem_size) {
-		message("Interface system is too large for device! Unrecoverable!\n");
-		std::exit(1);
-	} // if
+	bool valid_sub_size(data_token_t token, size_t system_size,
+		size_t num_systems, size_t sub_size);
+
+	bool valid_tuning(data_token_t token, size_t system_size,
+		size_t num_systems, const tuning_t & tuning);
 
-	interface_t * interface = create_interface_system(system_size,
-		num_systems, sub_size, sub_systems, a, b, c, d);
+	size_t max_sub_size(data_token_t token, size_t system_size);
 
 	/*-------------------------------------------------------------------------*
-	 * Create interface buffers.
+	 * Largest power-of-two system the PCR kernels solve in local memory.
+	 * Larger sub-systems first run global_levels PCR levels in global
+	 * memory, one launch per level, until the systems left fit.
 	 *-------------------------------------------------------------------------*/
-	cl_mem_flags is_flags = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
-	cl_mem d_ia, d_ib, d_ic, d_id, d_ix;
-	cl_mem d_a, d_b, d_c, d_d, d_x;
 
-	create_buffer(context, is_flags, interface_size*sizeof(real_t),
-		d_ia, interface->a);
-	create_buffer(context, is_flags, interface_size*sizeof(real_t),
-		d_ib, interface->b);
-	create_buffer(context, is_flags, interface_size*sizeof(real_t),
-		d_ic, interface->c);
-	create_buffer(context, is_flags, interface_size*sizeof(real_t),
-		d_id, interface->d);
-	create_buffer(context, CL_MEM_WRITE_ONLY, interface_size*sizeof(real_t),
-		d_ix, NULL);
+	size_t local_sub_size(data_token_t token);
+
+	size_t global_levels(data_token_t token, size_t sub_size) {
+		const size_t limit = local_sub_size(token);
+		size_t levels(0);
+
+		while((sub_size >> levels) > limit) {
+			++levels;
+		} // while
+
+		return levels;
+	} // global_levels
 
 	/*-------------------------------------------------------------------------*
-	 * Create system buffers.
+	 * Rows per work-item of pcr_rows_kernel (up to pcr_max_rows) and
+	 * pcr_fused_kernel (more).  A sub-system of sub_size rows runs in a
+	 * work group of sub_size/rows work-items, which must be a power of two,
+	 * so sub-systems larger than the one-row kernels allow still fit in one
+	 * work group.  A whole system solved this way may have any size.
+	 * default_rows returns the smallest valid count, or 1 (one row per
+	 * work-item) if there is none.  Callers with their own one-row kernels
+	 * (grid, smoothing, packed rows) pass thomas = false so that large
+	 * batches are not planned for thomas_kernel.
 	 *-------------------------------------------------------------------------*/
-	size_t full_size(system_size*num_systems);
 
-	create_buffer(context, CL_MEM_READ_WRITE, full_size*sizeof(real_t),
-		d_a, NULL);
-	create_buffer(context, CL_MEM_READ_WRITE, full_size*sizeof(real_t),
-		d_b, NULL);
-	create_buffer(context, CL_MEM_READ_WRITE, full_size*sizeof(real_t),
-		d_c, NULL);
-	create_buffer(context, CL_MEM_READ_WRITE, full_size*sizeof(real_t),
-		d_d, NULL);
-	create_buffer(context, CL_MEM_WRITE_ONLY, full_size*sizeof(real_t),
-		d_x, NULL);
+	bool valid_rows(data_token_t token, size_t sub_size, size_t rows);
+	size_t default_rows(data_token_t token, size_t sub_size);
+
+	tuning_t default_tuning(data_token_t token, size_t system_size,
+		size_t num_systems, bool thomas = true);
 
 	/*-------------------------------------------------------------------------*
-	 * Set interface arguments.
+	 * Strategy planner: pick host, direct or partitioned device solve for an
+	 * untuned shape from the cost model measured by calibrate.
 	 *-------------------------------------------------------------------------*/
-	ierr = 0;
-	ierr |= clSetKernelArg(pcr_kernel, 0, sizeof(cl_mem), &d_ia);
-	ierr |= clSetKernelArg(pcr_kernel, 1, sizeof(cl_mem), &d_ib);
-	ierr |= clSetKernelArg(pcr_kernel, 2, sizeof(cl_mem), &d_ic);
-	ierr |= clSetKernelArg(pcr_kernel, 3, sizeof(cl_mem), &d_id);
-	ierr |= clSetKernelArg(pcr_kernel, 4, sizeof(cl_mem), &d_ix);
-	ierr |= clSetKernelArg(pcr_kernel, 5,
-		(interface_size+1)*5*sizeof(real_t), NULL);
-	ierr |= clSetKernelArg(pcr_kernel, 6, sizeof(int32_t), &interface_size);
-	ierr |= clSetKernelArg(pcr_kernel, 7, sizeof(int32_t), &interface_systems);
-	ierr |= clSetKernelArg(pcr_kernel, 8, sizeof(int32_t),
-		&interface_iterations);
 
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clSetKernelArg, ierr);
-	} // if
+	tuning_t plan(data_token_t token, size_t system_size,
+		size_t num_systems, bool thomas = true);
+
+	void calibrate(data_token_t token);
+
+	TuningDB::key_t tuning_key(data_token_t token, size_t system_size,
+		size_t num_systems) {
+		return TuningDB::key_t(data(token).device_key,
+			TypeToOpt<real_t>::precision_string(), system_size, num_systems);
+	} // tuning_key
 
 	/*-------------------------------------------------------------------------*
-	 * Set copy arguments.
+	 * Enqueue the global-memory PCR levels and the local solve of the
+	 * systems left (into r.events[6]) for sub-systems that do not fit in
+	 * local memory.  The inputs are r.mem[5..8], r.mem[10..13] are the
+	 * ping-pong buffers.
 	 *-------------------------------------------------------------------------*/
-	ierr = 0;
-	ierr |= clSetKernelArg(copy_kernel, 0, sizeof(cl_mem), &d_a);
-	ierr |= clSetKernelArg(copy_kernel, 1, sizeof(cl_mem), &d_b);
-	ierr |= clSetKernelArg(copy_kernel, 2, sizeof(cl_mem), &d_c);
-	ierr |= clSetKernelArg(copy_kernel, 3, sizeof(cl_mem), &d_d);
-	ierr |= clSetKernelArg(copy_kernel, 4, sizeof(cl_mem), &d_ix);
-	ierr |= clSetKernelArg(copy_kernel, 5, sizeof(int32_t), &system_size);
-	ierr |= clSetKernelArg(copy_kernel, 6, sizeof(int32_t), &sub_size);
-
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clSetKernelArg, ierr);
-	} // if
 
-	size_t offset(0);
-	size_t global_size(interface_size);
-	size_t local_size(interface_size);
-	cl_event events[4];
-	cl_event event;
+	int32_t enqueue_global_pcr(thread_data_t & local,
+		cl_command_queue queue, solve_resources_t & r, cl_mem d_out,
+		size_t sub_size, size_t levels, size_t full_size);
 
 	/*-------------------------------------------------------------------------*
-	 * Solve interface system.
+	 * Device solve with explicit parameters, returns an OpenCL error code.
 	 *-------------------------------------------------------------------------*/
-	ierr = clEnqueueNDRangeKernel(queue, pcr_kernel, 1, &offset,
-		&global_size, &local_size, 0, NULL, &event);
 
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTkernel(clEnqueueNDRangeKernel, ierr, "solve");
-	} // if
+	int32_t solve(data_token_t token, const tuning_t & tuning,
+		size_t system_size, size_t num_systems, real_t * a, real_t * b,
+		real_t * c, real_t * d, real_t * x, double tolerance = 0.0,
+		double * bound = nullptr, real_t * norms = nullptr);
 
 	/*-------------------------------------------------------------------------*
-	 * Begin writing full system to device.
+	 * Enqueue residual_norms for the solution in d_x against the original
+	 * coefficients d_a..d_d, and read the per-system norms into norms
+	 * (events[12] and events[13]).  The global norms are added on the host.
 	 *-------------------------------------------------------------------------*/
-	ierr = 0;
-	ierr |= clEnqueueWriteBuffer(queue, d_a, 0, offset,
-		full_size*sizeof(real_t), a, 0, NULL, &events[0]);
-	ierr |= clEnqueueWriteBuffer(queue, d_b, 0, offset,
-		full_size*sizeof(real_t), b, 0, NULL, &events[1]);
-	ierr |= clEnqueueWriteBuffer(queue, d_c, 0, offset,
-		full_size*sizeof(real_t), c, 0, NULL, &events[2]);
-	ierr |= clEnqueueWriteBuffer(queue, d_d, 0, offset,
-		full_size*sizeof(real_t), d, 0, NULL, &events[3]);
-	
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clSetKernelArg, ierr);
-	} // if
+
+	int32_t residual_norms(data_token_t token, thread_data_t & local,
+		cl_command_queue queue, solve_resources_t & r, cl_mem d_a,
+		cl_mem d_b, cl_mem d_c, cl_mem d_d, cl_mem d_x, size_t system_size,
+		size_t num_systems, real_t * norms);
 
 	/*-------------------------------------------------------------------------*
-	 * Block for interface solve kernel.
+	 * Enqueue thomas_kernel for the systems in d_a..d_d, with scratch
+	 * buffer d_cp of the same size and the solution in d_x.  d_cp may be
+	 * d_c and d_x may be d_d, which then are overwritten.  solve_thomas is
+	 * solve for a one-work-item-per-system tuning.
 	 *-------------------------------------------------------------------------*/
-	ierr = clWaitForEvents(1, &event);
 
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clSetKernelArg, ierr);
-	} // if
+	int32_t enqueue_thomas(data_token_t token, thread_data_t & local,
+		cl_command_queue queue, cl_mem d_a, cl_mem d_b, cl_mem d_c,
+		cl_mem d_d, cl_mem d_cp, cl_mem d_x, size_t system_size,
+		size_t num_systems, cl_event * event);
+
+	int32_t solve_thomas(data_token_t token, thread_data_t & local,
+		size_t system_size, size_t num_systems, real_t * a, real_t * b,
+		real_t * c, real_t * d, real_t * x, real_t * norms);
+
+	static void global_norms(size_t num_systems, real_t * norms);
 
 	/*-------------------------------------------------------------------------*
-	 * Set full system arguments.
+	 * Solve with a tuned or planned configuration and host fallback, the
+	 * common path of the public solves.  x may be NULL if norms is not.
 	 *-------------------------------------------------------------------------*/
-	size_t sub_iterations(iterations(sub_size));
-	ierr = 0;
-	ierr |= clSetKernelArg(pcr_kernel, 0, sizeof(cl_mem), &d_a);
-	ierr |= clSetKernelArg(pcr_kernel, 1, sizeof(cl_mem), &d_b);
-	ierr |= clSetKernelArg(pcr_kernel, 2, sizeof(cl_mem), &d_c);
-	ierr |= clSetKernelArg(pcr_kernel, 3, sizeof(cl_mem), &d_d);
-	ierr |= clSetKernelArg(pcr_kernel, 4, sizeof(cl_mem), &d_x);
-	ierr |= clSetKernelArg(pcr_kernel, 5,
-		(interface_size+1)*5*sizeof(real_t), NULL);
-	ierr |= clSetKernelArg(pcr_kernel, 6, sizeof(int32_t), &sub_size);
-	ierr |= clSetKernelArg(pcr_kernel, 7, sizeof(int32_t), &sub_systems);
-	ierr |= clSetKernelArg(pcr_kernel, 8, sizeof(int32_t), &sub_iterations);
 
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clSetKernelArg, ierr);
-	} // if
+	int32_t solve_planned(data_token_t token, size_t system_size,
+		size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+		real_t * x, double tolerance, double * bound, real_t * norms);
 
 	/*-------------------------------------------------------------------------*
-	 * Block for full system write.
+	 * Truncated SPIKE: solve the interface system approximately, coupling
+	 * only the last row of each partition with the first row of the next,
+	 * and store the values in interface.x.  Returns the bound rho on the
+	 * relative error, or infinity if the system is not diagonally
+	 * dominant.
 	 *-------------------------------------------------------------------------*/
-	ierr = clWaitForEvents(4, events);
 
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clWaitForEvents, ierr);
-	} // if
+	double truncate_interface(interface_t & interface, size_t full_size,
+		const real_t * a, const real_t * b, const real_t * c);
 
 	/*-------------------------------------------------------------------------*
-	 * Copy interface results into full system.
+	 * Lines of a strided grid.  Line l of length system_size starts at
+	 * (l % lines0)*stride0 + (l / lines0)*stride1 and its rows are stride
+	 * elements apart; extent is the number of elements spanned.
 	 *-------------------------------------------------------------------------*/
-	global_size = interface_size;
-	local_size = interface_size/num_systems;
 
-	ierr = clEnqueueNDRangeKernel(queue, copy_kernel, 1, &offset,
-		&global_size, &local_size, 0, NULL, &event);
+	struct grid_lines_t {
+		size_t system_size;
+		size_t num_lines;
+		size_t lines0;
+		size_t stride;
+		size_t stride0;
+		size_t stride1;
+		size_t extent;
+		bool dense;
+	}; // struct grid_lines_t
+
+	int32_t solve_grid_device(data_token_t token, const grid_lines_t & lines,
+		real_t * a, real_t * b, real_t * c, real_t * d, real_t * x);
 
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTkernel(clEnqueueNDRangeKernel, ierr, "solve");
-	} // if
+	int32_t solve_grid_host(const grid_lines_t & lines, const real_t * a,
+		const real_t * b, const real_t * c, const real_t * d, real_t * x);
 
 	/*-------------------------------------------------------------------------*
-	 * Block for copy operation.
+	 * Ragged batches.  The device solve bins the systems by work-group size
+	 * (one work-item per block of at least three rows) and enqueues one
+	 * pcr_ragged_kernel launch per bin between a single upload and a single
+	 * readback, with one wait at the end.
 	 *-------------------------------------------------------------------------*/
-	ierr = clWaitForEvents(1, &event);
 
-	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clSetKernelArg, ierr);
-	} // if
+	int32_t solve_ragged_device(data_token_t token, size_t num_systems,
+		const size_t * offsets, real_t * a, real_t * b, real_t * c,
+		real_t * d, real_t * x);
+
+	int32_t solve_ragged_host(size_t num_systems, const size_t * offsets,
+		const real_t * a, const real_t * b, const real_t * c,
+		const real_t * d, real_t * x);
 
 	/*-------------------------------------------------------------------------*
-	 * Solve full system.
+	 * Line smoothing.  The device version enqueues every sweep (one
+	 * line_smooth launch each, ping-ponging u between two buffers) before
+	 * a single readback and wait.
 	 *-------------------------------------------------------------------------*/
-	global_size = full_size;
-	local_size = sub_size;
 
-	ierr = clEnqueueNDRangeKernel(queue, pcr_kernel, 1, &offset,
-		&global_size, &local_size, 0, NULL, &event);
+	int32_t smooth_device(data_token_t token, size_t system_size,
+		size_t num_lines, const real_t * a, const real_t * b,
+		const real_t * c, const real_t * s, const real_t * n,
+		const real_t * f, real_t * u, real_t omega, size_t sweeps);
+
+	int32_t smooth_host(size_t system_size, size_t num_lines,
+		const real_t * a, const real_t * b, const real_t * c,
+		const real_t * s, const real_t * n, const real_t * f, real_t * u,
+		real_t omega, size_t sweeps);
+
+	/*-------------------------------------------------------------------------*
+	 * Symmetric solves.  symmetric_sub_size returns the largest sub-system
+	 * size for which the symmetric kernels fit (whole systems first, then
+	 * partitions of at least four rows with a symmetric interface system),
+	 * or 0 if there is none.  The device solve enqueues every step before
+	 * a single wait.
+	 *-------------------------------------------------------------------------*/
+
+	size_t symmetric_sub_size(data_token_t token, size_t system_size,
+		size_t num_systems);
+
+	int32_t solve_symmetric_device(data_token_t token, size_t sub_size,
+		size_t system_size, size_t num_systems, real_t * b, real_t * e,
+		real_t * d, real_t * x);
+
+	/*-------------------------------------------------------------------------*
+	 * Packed solve of systems that fit in one work group: the rows are
+	 * uploaded as one buffer and read with vload4.
+	 *-------------------------------------------------------------------------*/
+
+	int32_t solve_packed_device(data_token_t token, size_t system_size,
+		size_t num_systems, const real_t * rows, real_t * x);
+
+	/*-------------------------------------------------------------------------*
+	 * Serial Thomas solve on the host.  thomas_host solves one system whose
+	 * rows are stride apart, with w as scratch for system_size values; x
+	 * may be d.
+	 *-------------------------------------------------------------------------*/
+
+	static void thomas_host(size_t system_size, size_t stride,
+		const real_t * a, const real_t * b, const real_t * c,
+		const real_t * d, real_t * x, real_t * w);
+
+	int32_t solve_host(size_t system_size, size_t num_systems,
+		const real_t * a, const real_t * b, const real_t * c,
+		const real_t * d, real_t * x);
+
+	void residual_norms_host(size_t system_size, size_t num_systems,
+		const real_t * a, const real_t * b, const real_t * c,
+		const real_t * d, const real_t * x, real_t * norms);
+
+	/*-------------------------------------------------------------------------*
+	 * Create interface systems.
+	 *-------------------------------------------------------------------------*/
+
+	interface_t * create_interface_system(size_t system_size,
+		size_t num_systems, size_t sub_size, size_t sub_systems,
+		real_t * a, real_t * b, real_t * c, real_t * d);
+
+	// the interface of a symmetric system is symmetric: only b, c and d
+	// are set
+	interface_t * create_symmetric_interface_system(size_t system_size,
+		size_t num_systems, size_t sub_size, size_t sub_systems,
+		const real_t * b, const real_t * e, const real_t * d);
+
+	int32_t create_buffer(cl_context & context, cl_mem_flags flags,
+		size_t bytes, cl_mem & d_p, void * h_p);
+
+	/*-------------------------------------------------------------------------*
+	 * Get device info.
+	 *-------------------------------------------------------------------------*/
+
+	device_info_t get_device_info(cl_device_id & id);
+
+	/*-------------------------------------------------------------------------*
+	 * Get kernel info.
+	 *-------------------------------------------------------------------------*/
+
+	kernel_work_group_info_t get_kernel_work_group_info(cl_device_id & id,
+		device_info_t & device_info, cl_kernel & kernel);
+
+	/*-------------------------------------------------------------------------*
+	 * Iterations for cyclic reduction.
+	 *-------------------------------------------------------------------------*/
+
+	size_t iterations(size_t elements) {
+		size_t ita(elements/2);
+		size_t cnt(0);
+		while(ita>1) { ++cnt; ita/=2; }
+		return cnt;
+	} // iterations
+
+	/*-------------------------------------------------------------------------*
+	 * Local memory used by the PCR kernel for one system, including the two
+	 * convergence flags of pcr_adaptive_kernel.
+	 *-------------------------------------------------------------------------*/
+
+	size_t pcr_local_memory(size_t elements) {
+		return ((elements+1)*5 + 2)*sizeof(real_t);
+	} // pcr_local_memory
+
+	/*-------------------------------------------------------------------------*
+	 * Work-group size for a line padded with identity rows: the smallest
+	 * power of two, at least two, that holds system_size rows.
+	 *-------------------------------------------------------------------------*/
+
+	static size_t padded_size(size_t system_size) {
+		size_t items(2);
+
+		while(items < system_size) {
+			items *= 2;
+		} // while
+
+		return items;
+	} // padded_size
+
+	/*-------------------------------------------------------------------------*
+	 * One work-item per system (thomas_kernel) is stored as rows ==
+	 * sub_size == system_size, which no PCR kernel accepts.  It is valid
+	 * if a work group of thomas_group_size systems fits, and chosen by
+	 * default once num_systems reaches thomas_systems, enough work groups
+	 * to keep every compute unit busy.
+	 *-------------------------------------------------------------------------*/
+
+	static bool thomas_tuning(const tuning_t & tuning, size_t system_size) {
+		return tuning.rows > 1 && tuning.rows == system_size;
+	} // thomas_tuning
+
+	size_t thomas_local_memory(size_t systems) {
+		return 4*systems*(thomas_tile+1)*sizeof(real_t);
+	} // thomas_local_memory
+
+	size_t thomas_group_size(data_token_t token) {
+		const cl_ulong local_mem_size = data(token).device_info.local_mem_size;
+		const size_t limit = std::min(data(token).kernel_info.work_group_size,
+			thomas_max_group);
+		size_t group(0);
+
+		for(size_t g(1); g <= limit && thomas_local_memory(g) <= local_mem_size;
+			g *= 2) {
+			group = g;
+		} // for
+
+		return group;
+	} // thomas_group_size
+
+	size_t thomas_systems(data_token_t token) {
+		return 8*data(token).device_info.max_compute_units*
+			thomas_group_size(token);
+	} // thomas_systems
+
+	/*-------------------------------------------------------------------------*
+	 * Local memory used by pcr_rows_kernel for one work group of items
+	 * work-items: the reduced system and the last row of each block.
+	 *-------------------------------------------------------------------------*/
+
+	size_t pcr_rows_local_memory(size_t items) {
+		return pcr_local_memory(items) + 3*items*sizeof(real_t);
+	} // pcr_rows_local_memory
+
+	/*-------------------------------------------------------------------------*
+	 * Local memory used by pcr_symmetric_kernel: b, c, d and x.
+	 *-------------------------------------------------------------------------*/
+
+	size_t pcr_symmetric_local_memory(size_t elements) {
+		return (elements+1)*4*sizeof(real_t);
+	} // pcr_symmetric_local_memory
+
+	/*-------------------------------------------------------------------------*
+	 * Multi-row kernel for a number of rows per work-item: private memory
+	 * up to pcr_max_rows, global memory beyond.  Both take the same
+	 * arguments.
+	 *-------------------------------------------------------------------------*/
+
+	static cl_kernel rows_kernel(const thread_data_t & local, size_t rows) {
+		return rows > pcr_max_rows ? local.fused_kernel : local.rows_kernel;
+	} // rows_kernel
+
+	/*-------------------------------------------------------------------------*
+	 * Private data members.
+	 *-------------------------------------------------------------------------*/
+
+	static const size_t max_tokens = 64;
+
+	// PCR_MAX_ROWS in tricycl.cl
+	static const size_t pcr_max_rows = 16;
+
+	// THOMAS_TILE in tricycl.cl; larger groups only add local memory
+	static const size_t thomas_tile = 16;
+	static const size_t thomas_max_group = 64;
+
+	// written once by init, read without locking
+	std::atomic<solver_data_t *> data_[max_tokens];
+	std::atomic<size_t> num_tokens_;
+	std::mutex init_mutex_;
+
+	// device-resident batches by handle
+	std::map<batch_token_t, batch_t *> batches_;
+	batch_token_t next_batch_;
+	std::mutex batch_mutex_;
+
+}; // class TriCyCL
+
+/*----------------------------------------------------------------------------*
+ * Init
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+typename TriCyCL<real_t>::data_token_t
+TriCyCL<real_t>::init(cl_device_id & id, cl_context & context,
+	cl_command_queue & queue) {
+	int32_t ierr = 0;
+	std::lock_guard<std::mutex> lock(init_mutex_);
+
+	if(num_tokens_ == max_tokens) {
+		std::cerr << "TriCyCL supports at most " << max_tokens <<
+			" tokens" << std::endl;
+		std::exit(1);
+	} // if
+
+	solver_data_t * solver_data = new solver_data_t(id, context, queue);
+	solver_data_t & _solver_data = *solver_data;
+
+	// create and compile the program
+	_solver_data.program = build_program(_solver_data,
+		TypeToOpt<real_t>::option_string());
+
+	if(_solver_data.program == NULL) {
+		std::exit(1);
+	} // if
+
+	// create solver kernel
+	_solver_data.pcr_kernel = clCreateKernel(_solver_data.program,
+		"pcr_branch_free_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		std::cerr << "clCreateKernel failed with " << ierr << std::endl;
+		std::exit(1);
+	} // if
+
+	// device and kernel limits used to choose solver parameters
+	_solver_data.device_info = get_device_info(_solver_data.id);
+	_solver_data.kernel_info = get_kernel_work_group_info(_solver_data.id,
+		_solver_data.device_info, _solver_data.pcr_kernel);
+	_solver_data.device_key =
+		TuningDB::device_key(_solver_data.device_info.name);
+
+	// shape-specialized kernels, unless disabled with TRICYCL_JIT=0
+	const char * jit = std::getenv("TRICYCL_JIT");
+	const char * jit_cache_size = std::getenv("TRICYCL_JIT_CACHE_SIZE");
+
+	if(jit == nullptr || std::atoi(jit) != 0) {
+		_solver_data.jit_cache = new JITCache(jit_cache_size == nullptr ?
+			16 : std::atoi(jit_cache_size));
+	} // if
+
+	// other threads create their queues with the same properties
+	clGetCommandQueueInfo(queue, CL_QUEUE_PROPERTIES,
+		sizeof(cl_command_queue_properties), &_solver_data.queue_properties,
+		NULL);
+
+	// planner and host fallback, unless disabled with TRICYCL_PLANNER=0
+	// or TRICYCL_HOST_FALLBACK=0
+	const char * planner = std::getenv("TRICYCL_PLANNER");
+	const char * host_fallback = std::getenv("TRICYCL_HOST_FALLBACK");
+
+	_solver_data.planner = planner == nullptr || std::atoi(planner) != 0;
+	_solver_data.host_fallback = host_fallback == nullptr ||
+		std::atoi(host_fallback) != 0;
+
+	// previously tuned parameters
+	TuningDB::instance().load();
+
+	const size_t token = num_tokens_;
+	data_[token].store(solver_data, std::memory_order_release);
+	num_tokens_ = token+1;
+
+	if(_solver_data.planner) {
+		calibrate(token);
+	} // if
+
+	return token;
+} // TriCyCL<>::init
+
+/*----------------------------------------------------------------------------*
+ * Build program.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+cl_program
+TriCyCL<real_t>::build_program(solver_data_t & solver_data,
+	const std::string & compile_options) {
+	int32_t ierr = 0;
+
+	// create program object
+	cl_program program = clCreateProgramWithSource(solver_data.context,
+		1, (const char **)&tricycl_PPSTR, NULL, &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		error("clCreateProgramWithSource failed with %d\n", ierr);
+		return NULL;
+	} // if
+
+	// compile the program
+	ierr = clBuildProgram(program, 1, &solver_data.id,
+		compile_options.c_str(), NULL, NULL);
+
+	// output something useful if the build fails
+	if(ierr == CL_BUILD_PROGRAM_FAILURE) {
+		char buffer[256*1024];
+		size_t length;
+
+		clGetProgramBuildInfo(program, solver_data.id,
+			CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &length);
+
+		error("clBuildProgram failed:\n%s\n%s\n", buffer,
+			compile_options.c_str());
+		clReleaseProgram(program);
+		return NULL;
+	} // if
+
+	return program;
+} // TriCyCL<>::build_program
+
+/*----------------------------------------------------------------------------*
+ * Thread data.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+typename TriCyCL<real_t>::thread_data_t *
+TriCyCL<real_t>::thread_data(data_token_t token) {
+	CALLER_SELF
+	static thread_local thread_data_list_t local;
+	int32_t ierr = 0;
+
+	if(local.data.size() <= token) {
+		local.data.resize(token+1, NULL);
+	} // if
+
+	if(local.data[token] != NULL) {
+		return local.data[token];
+	} // if
+
+	solver_data_t & solver_data = data(token);
+	thread_data_t * thread_data = new thread_data_t;
+
+	if(std::this_thread::get_id() == solver_data.init_thread) {
+		thread_data->queue = solver_data.queue;
+	}
+	else {
+		thread_data->queue = clCreateCommandQueue(solver_data.context,
+			solver_data.id, solver_data.queue_properties, &ierr);
+		thread_data->owns_queue = ierr == CL_SUCCESS;
+
+		if(ierr != CL_SUCCESS) {
+			delete thread_data;
+			CL_RETURNerr(clCreateCommandQueue, ierr, NULL);
+		} // if
+	} // if
+
+	thread_data->copy_kernel = clCreateKernel(solver_data.program,
+		"uncouple", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "uncouple", NULL);
+	} // if
+
+	thread_data->strided_kernel = clCreateKernel(solver_data.program,
+		"pcr_strided_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_strided_kernel", NULL);
+	} // if
+
+	thread_data->truncated_kernel = clCreateKernel(solver_data.program,
+		"pcr_truncated_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_truncated_kernel", NULL);
+	} // if
+
+	thread_data->global_kernel = clCreateKernel(solver_data.program,
+		"pcr_global_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_global_kernel", NULL);
+	} // if
+
+	thread_data->rows_kernel = clCreateKernel(solver_data.program,
+		"pcr_rows_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_rows_kernel", NULL);
+	} // if
+
+	thread_data->fused_kernel = clCreateKernel(solver_data.program,
+		"pcr_fused_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_fused_kernel", NULL);
+	} // if
+
+	thread_data->ragged_kernel = clCreateKernel(solver_data.program,
+		"pcr_ragged_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_ragged_kernel", NULL);
+	} // if
+
+	thread_data->smooth_kernel = clCreateKernel(solver_data.program,
+		"line_smooth", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "line_smooth", NULL);
+	} // if
+
+	thread_data->symmetric_kernel = clCreateKernel(solver_data.program,
+		"pcr_symmetric_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_symmetric_kernel", NULL);
+	} // if
+
+	thread_data->symmetric_copy_kernel = clCreateKernel(solver_data.program,
+		"uncouple_symmetric", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "uncouple_symmetric", NULL);
+	} // if
+
+	thread_data->packed_kernel = clCreateKernel(solver_data.program,
+		"pcr_packed_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "pcr_packed_kernel", NULL);
+	} // if
+
+	thread_data->thomas_kernel = clCreateKernel(solver_data.program,
+		"thomas_kernel", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "thomas_kernel", NULL);
+	} // if
+
+	thread_data->gather_kernel = clCreateKernel(solver_data.program,
+		"gather_systems", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "gather_systems", NULL);
+	} // if
+
+	thread_data->scatter_kernel = clCreateKernel(solver_data.program,
+		"scatter_systems", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "scatter_systems", NULL);
+	} // if
+
+	thread_data->residual_kernel = clCreateKernel(solver_data.program,
+		"residual_norms", &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		delete thread_data;
+		CL_RETURNkernel(clCreateKernel, ierr, "residual_norms", NULL);
+	} // if
+
+	local.data[token] = thread_data;
+
+	return thread_data;
+} // TriCyCL<>::thread_data
+
+/*----------------------------------------------------------------------------*
+ * PCR kernel of the calling thread for a program.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+cl_kernel
+TriCyCL<real_t>::thread_pcr_kernel(data_token_t token, cl_program program,
+	pcr_variant_t variant) {
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL || program == NULL) {
+		return NULL;
+	} // if
+
+	const std::pair<cl_program, pcr_variant_t> key(program, variant);
+	typename std::map<std::pair<cl_program, pcr_variant_t>,
+		cl_kernel>::iterator ita = local->pcr_kernels.find(key);
+
+	if(ita != local->pcr_kernels.end()) {
+		return ita->second;
+	} // if
+
+	int32_t ierr = 0;
+	cl_kernel kernel = clCreateKernel(program, pcr_kernel_name(variant),
+		&ierr);
+
+	if(ierr != CL_SUCCESS) {
+		return NULL;
+	} // if
+
+	local->pcr_kernels[key] = kernel;
+
+	return kernel;
+} // TriCyCL<>::thread_pcr_kernel
+
+/*----------------------------------------------------------------------------*
+ * Native-divide PCR program.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+cl_program
+TriCyCL<real_t>::native_program(data_token_t token) {
+	solver_data_t & solver_data = data(token);
+
+	std::call_once(solver_data.native_once, [&solver_data, this]() {
+		solver_data.native_program = build_program(solver_data,
+			std::string(TypeToOpt<real_t>::option_string()) +
+			" -DNATIVE_DIVIDE");
+	});
+
+	return solver_data.native_program;
+} // TriCyCL<>::native_program
+
+/*----------------------------------------------------------------------------*
+ * Select PCR kernel.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+cl_kernel
+TriCyCL<real_t>::select_pcr_kernel(data_token_t token, size_t system_size,
+	bool native_divide, pcr_variant_t variant) {
+	solver_data_t & solver_data = data(token);
+	cl_kernel generic = thread_pcr_kernel(token, native_divide ?
+		native_program(token) : solver_data.program, variant);
+
+	if(generic == NULL) {
+		return NULL;
+	} // if
+
+	if(solver_data.jit_cache == NULL) {
+		return generic;
+	} // if
+
+	JITCache::key_t key(system_size, native_divide);
+	JITCache::entry_t * created = NULL;
+	cl_program program = solver_data.jit_cache->acquire(key, solver_data.id,
+		created);
+
+	if(created != NULL) {
+		build_specialization(solver_data, created);
+	} // if
+
+	// use the generic kernel while the specialization builds
+	if(program == NULL) {
+		return generic;
+	} // if
+
+	cl_kernel kernel = thread_pcr_kernel(token, program, variant);
+	clReleaseProgram(program);
+
+	if(kernel == NULL) {
+		warning("clCreateKernel failed for system size %d\n",
+			(int)system_size);
+		return generic;
+	} // if
+
+	return kernel;
+} // TriCyCL<>::select_pcr_kernel
+
+/*----------------------------------------------------------------------------*
+ * Start building a specialized program.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+void
+TriCyCL<real_t>::build_specialization(solver_data_t & solver_data,
+	JITCache::entry_t * entry) {
+	int32_t ierr = 0;
+	std::ostringstream compile_options;
+
+	compile_options << TypeToOpt<real_t>::option_string() <<
+		" -DSYSTEM_SIZE=" << entry->key.system_size <<
+		" -DITERATIONS=" << iterations(entry->key.system_size);
+
+	if(entry->key.native_divide) {
+		compile_options << " -DNATIVE_DIVIDE";
+	} // if
+
+	entry->program = clCreateProgramWithSource(solver_data.context,
+		1, (const char **)&tricycl_PPSTR, NULL, &ierr);
+
+	if(ierr != CL_SUCCESS) {
+		entry->status = JITCache::failed;
+		return;
+	} // if
+
+	// returns immediately, JITCache::notify reports completion
+	ierr = clBuildProgram(entry->program, 1, &entry->id,
+		compile_options.str().c_str(), JITCache::notify, entry);
+
+	if(ierr != CL_SUCCESS) {
+		warning("clBuildProgram failed for %s\n",
+			compile_options.str().c_str());
+		entry->status = JITCache::failed;
+	} // if
+} // TriCyCL<>::build_specialization
+
+/*----------------------------------------------------------------------------*
+ * Block until no specialized program is building.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+void
+TriCyCL<real_t>::wait_for_specializations(data_token_t token) {
+	JITCache * jit_cache = data(token).jit_cache;
+
+	while(jit_cache != NULL && jit_cache->building_count() > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	} // while
+} // TriCyCL<>::wait_for_specializations
+
+/*----------------------------------------------------------------------------*
+ * Check a sub-system size.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+bool
+TriCyCL<real_t>::valid_sub_size(data_token_t token, size_t system_size,
+	size_t num_systems, size_t sub_size) {
+	const size_t work_group_size = data(token).kernel_info.work_group_size;
+	const cl_ulong local_mem_size = data(token).device_info.local_mem_size;
+
+	// the PCR kernel wraps indices with a power-of-two mask
+	if(sub_size < 2 || (sub_size & (sub_size-1)) != 0 ||
+		system_size%sub_size != 0) {
+		return false;
+	} // if
+
+	// larger sub-systems start in global memory (see global_levels)
+	if(local_sub_size(token) < 2) {
+		return false;
+	} // if
+
+	// a single sub-system is solved directly, without an interface system
+	if(sub_size == system_size) {
+		return true;
+	} // if
+
+	const size_t interface_size(2*(system_size/sub_size)*num_systems);
+
+	return (interface_size & (interface_size-1)) == 0 &&
+		interface_size <= work_group_size &&
+		pcr_local_memory(interface_size) <= local_mem_size;
+} // TriCyCL<>::valid_sub_size
+
+/*----------------------------------------------------------------------------*
+ * Check a complete set of solver parameters.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+bool
+TriCyCL<real_t>::valid_tuning(data_token_t token, size_t system_size,
+	size_t num_systems, const tuning_t & tuning) {
+	// the multi-row kernels only need a power-of-two number of work-items,
+	// so a whole system of any size can be solved in one work group
+	const bool whole(tuning.rows > 1 && tuning.sub_size == system_size);
+
+	if(thomas_tuning(tuning, system_size)) {
+		return whole && thomas_group_size(token) > 0;
+	} // if
+
+	return tuning.variant < pcr_num_variants &&
+		(!tuning.native_divide || TypeToOpt<real_t>::native_divide()) &&
+		(whole ||
+		valid_sub_size(token, system_size, num_systems, tuning.sub_size)) &&
+		valid_rows(token, tuning.sub_size, tuning.rows);
+} // TriCyCL<>::valid_tuning
+
+/*----------------------------------------------------------------------------*
+ * Check the rows per work-item for a sub-system size.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+bool
+TriCyCL<real_t>::valid_rows(data_token_t token, size_t sub_size,
+	size_t rows) {
+	const size_t work_group_size = data(token).kernel_info.work_group_size;
+	const cl_ulong local_mem_size = data(token).device_info.local_mem_size;
+
+	if(rows == 1) {
+		return true;
+	} // if
+
+	const size_t items(sub_size/rows);
+
+	// pcr_local needs at least two (a power of two) work-items
+	if(rows < 4 || sub_size%rows != 0 || items < 2 ||
+		(items & (items-1)) != 0) {
+		return false;
+	} // if
+
+	return items <= work_group_size &&
+		pcr_rows_local_memory(items) <= local_mem_size;
+} // TriCyCL<>::valid_rows
+
+/*----------------------------------------------------------------------------*
+ * Smallest valid rows per work-item larger than one, i.e. the most
+ * work-items.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+size_t
+TriCyCL<real_t>::default_rows(data_token_t token, size_t sub_size) {
+	for(size_t items(max_sub_size(token, sub_size/4)); items > 1;
+		items /= 2) {
+		if(sub_size%items == 0 && valid_rows(token, sub_size, sub_size/items)) {
+			return sub_size/items;
+		} // if
+	} // for
+
+	return 1;
+} // TriCyCL<>::default_rows
+
+/*----------------------------------------------------------------------------*
+ * Largest power-of-two sub-system size that fits in a work group.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+size_t
+TriCyCL<real_t>::max_sub_size(data_token_t token, size_t system_size) {
+	const size_t limit = std::min(data(token).kernel_info.work_group_size,
+		system_size);
+	size_t sub_size(1);
+
+	while(2*sub_size <= limit) {
+		sub_size *= 2;
+	} // while
+
+	return sub_size;
+} // TriCyCL<>::max_sub_size
+
+/*----------------------------------------------------------------------------*
+ * Largest power-of-two system that fits in local memory.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+size_t
+TriCyCL<real_t>::local_sub_size(data_token_t token) {
+	const cl_ulong local_mem_size = data(token).device_info.local_mem_size;
+	size_t sub_size(max_sub_size(token,
+		std::numeric_limits<size_t>::max()));
+
+	while(sub_size > 1 && pcr_local_memory(sub_size) > local_mem_size) {
+		sub_size /= 2;
+	} // while
+
+	return sub_size;
+} // TriCyCL<>::local_sub_size
+
+/*----------------------------------------------------------------------------*
+ * Untuned solver parameters: the whole system if it fits in local memory
+ * with one row per work-item, otherwise the whole system with several
+ * rows per work-item (a single launch with no interface system), then the
+ * largest valid sub-system that fits in local memory, otherwise the
+ * smallest valid one that does not, solved with several rows per
+ * work-item if possible and with global-memory levels if not.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+tuning_t
+TriCyCL<real_t>::default_tuning(data_token_t token, size_t system_size,
+	size_t num_systems, bool thomas) {
+	tuning_t tuning;
+	const size_t limit = local_sub_size(token);
+
+	// the batch alone fills the device
+	if(thomas && system_size > 1 && thomas_group_size(token) > 0 &&
+		num_systems >= thomas_systems(token)) {
+		tuning.sub_size = system_size;
+		tuning.rows = system_size;
+		return tuning;
+	} // if
+
+	if(system_size > limit || (system_size & (system_size-1)) != 0) {
+		const size_t rows = default_rows(token, system_size);
+
+		if(rows > 1) {
+			tuning.sub_size = system_size;
+			tuning.rows = rows;
+			return tuning;
+		} // if
+	} // if
+
+	for(size_t sub_size(std::min(limit, max_sub_size(token, system_size)));
+		sub_size > 1; sub_size /= 2) {
+		if(valid_sub_size(token, system_size, num_systems, sub_size)) {
+			tuning.sub_size = sub_size;
+			return tuning;
+		} // if
+	} // for
+
+	for(size_t sub_size(2*limit); sub_size <= system_size; sub_size *= 2) {
+		if(valid_sub_size(token, system_size, num_systems, sub_size)) {
+			tuning.sub_size = sub_size;
+			tuning.rows = default_rows(token, sub_size);
+			return tuning;
+		} // if
+	} // for
+
+	return tuning;
+} // TriCyCL<>::default_tuning
+
+/*----------------------------------------------------------------------------*
+ * Plan.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+tuning_t
+TriCyCL<real_t>::plan(data_token_t token, size_t system_size,
+	size_t num_systems, bool thomas) {
+	solver_data_t & solver_data = data(token);
+	const cost_model_t & model = solver_data.cost_model;
+	const double rows(system_size*num_systems);
+
+	// sub_size is zero (host) if no device configuration is valid
+	tuning_t device = default_tuning(token, system_size, num_systems,
+		thomas);
+
+	if(!solver_data.planner || device.sub_size == 0) {
+		return device;
+	} // if
+
+	double device_cost = model.device_latency + model.device_row*rows;
+
+	if(device.sub_size != system_size) {
+		device_cost += model.partition_latency + model.interface_row*rows;
+	} // if
+
+	if(device_cost < model.host_row*rows) {
+		return device;
+	} // if
+
+	return tuning_t();
+} // TriCyCL<>::plan
+
+/*----------------------------------------------------------------------------*
+ * Calibrate.
+ *
+ * Times host and device solves of a few small shapes (minimum of three
+ * after a warm-up) and fits the cost model.  Devices that cannot solve
+ * the calibration shapes are given an infinite latency.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+void
+TriCyCL<real_t>::calibrate(data_token_t token) {
+	const double infinity = std::numeric_limits<double>::max();
+	const size_t n = max_sub_size(token, 64);
+	const size_t m = 16;
+	const size_t repetitions(3);
+	cost_model_t & model = data(token).cost_model;
+
+	// diagonally dominant, sized for 2n x m rows
+	std::vector<real_t> a(2*n*m, -1.0);
+	std::vector<real_t> b(2*n*m, 4.0);
+	std::vector<real_t> c(2*n*m, -1.0);
+	std::vector<real_t> d(2*n*m, 1.0);
+	std::vector<real_t> x(2*n*m);
+
+	a[0] = 0.0;
+	c[2*n*m-1] = 0.0;
+
+	// calibration solves are not reported in the statistics
+	Stats::instance().pause(true);
+
+	auto time_solve = [&](size_t system_size, size_t num_systems,
+		size_t sub_size) -> double {
+		tuning_t tuning;
+		tuning.sub_size = sub_size;
+		double seconds = infinity;
+
+		if(sub_size != 0 &&
+			!valid_tuning(token, system_size, num_systems, tuning)) {
+			return infinity;
+		} // if
+
+		for(size_t r(0); r<repetitions+1; ++r) {
+			const Stats::time_point_t start = Stats::now();
+			const int32_t ierr = sub_size == 0 ?
+				solve_host(system_size, num_systems, &a[0], &b[0], &c[0],
+					&d[0], &x[0]) :
+				solve(token, tuning, system_size, num_systems, &a[0], &b[0],
+					&c[0], &d[0], &x[0]);
+
+			if(ierr != CL_SUCCESS) {
+				return infinity;
+			} // if
+
+			// the first solve only warms up
+			if(r == 0) {
+				wait_for_specializations(token);
+				continue;
+			} // if
+
+			seconds = std::min(seconds,
+				std::chrono::duration<double>(Stats::now() - start).count());
+		} // for
+
+		return seconds;
+	};
+
+	model.host_row = time_solve(n, m, 0)/(n*m);
+
+	double interface_seconds = infinity;
+	for(size_t r(0); r<repetitions; ++r) {
+		const Stats::time_point_t start = Stats::now();
+		delete create_interface_system(2*n, m, n, 2, &a[0], &b[0], &c[0],
+			&d[0]);
+		interface_seconds = std::min(interface_seconds,
+			std::chrono::duration<double>(Stats::now() - start).count());
+	} // for
+
+	model.interface_row = interface_seconds/(2*n*m);
+
+	const double single = time_solve(n, 1, n);
+	const double multiple = time_solve(n, m, n);
+	const double partitioned = time_solve(2*n, 1, n);
+
+	if(single == infinity || multiple == infinity) {
+		model.device_latency = infinity;
+	}
+	else {
+		model.device_row = std::max(0.0, (multiple - single)/(n*(m-1)));
+		model.device_latency = std::max(0.0, single - model.device_row*n);
+	} // if
+
+	model.partition_latency = partitioned == infinity ? infinity :
+		std::max(0.0, partitioned - model.device_latency -
+		2*n*(model.device_row + model.interface_row));
+
+	Stats::instance().pause(false);
+
+	message("calibrate: host_row %e interface_row %e device_latency %e "
+		"device_row %e partition_latency %e\n", model.host_row,
+		model.interface_row, model.device_latency, model.device_row,
+		model.partition_latency);
+} // TriCyCL<>::calibrate
+
+/*----------------------------------------------------------------------------*
+ * Tune.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::tune(data_token_t token, size_t system_size,
+	size_t num_systems, tuning_t & tuning) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(system_size == 0 || num_systems == 0) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	const size_t repetitions(3);
+	const size_t full_size(system_size*num_systems);
+	const pcr_variant_t variants[] = { pcr_branch_free, pcr_adaptive };
+	const size_t num_variants(sizeof(variants)/sizeof(pcr_variant_t));
+	const size_t divide_modes(TypeToOpt<real_t>::native_divide() ? 2 : 1);
+
+	/*-------------------------------------------------------------------------*
+	 * Diagonally dominant test system.
+	 *-------------------------------------------------------------------------*/
+	std::vector<real_t> a, b, c, d, x;
+
+	try {
+		a.assign(full_size, -1.0);
+		b.assign(full_size, 4.0);
+		c.assign(full_size, -1.0);
+		d.resize(full_size);
+		x.resize(full_size);
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	for(size_t s(0); s<num_systems; ++s) {
+		a[s*system_size] = 0.0;
+		c[s*system_size + system_size-1] = 0.0;
+	} // for
+
+	for(size_t i(0); i<full_size; ++i) {
+		d[i] = std::sin(real_t(i));
+	} // for
+
+	/*-------------------------------------------------------------------------*
+	 * The host solver is always a candidate.
+	 *-------------------------------------------------------------------------*/
+	tuning_t best;
+	best.sub_size = 0;
+	best.seconds = std::numeric_limits<double>::max();
+
+	// tuning solves are not reported in the statistics
+	Stats::instance().pause(true);
+
+	for(size_t r(0); r<repetitions+1; ++r) {
+		const Stats::time_point_t start = Stats::now();
+
+		solve_host(system_size, num_systems, &a[0], &b[0], &c[0], &d[0],
+			&x[0]);
+
+		// the first solve only warms up the cache
+		if(r > 0) {
+			best.seconds = std::min(best.seconds,
+				std::chrono::duration<double>(Stats::now() - start).count());
+		} // if
+	} // for
+
+	message("tune: host: %e s\n", best.seconds);
+
+	/*-------------------------------------------------------------------------*
+	 * Sweep sub-system size, rows per work-item, kernel variant and divide
+	 * mode.
+	 *-------------------------------------------------------------------------*/
+
+	std::vector<size_t> sub_sizes;
+	size_t largest(1);
+
+	while(2*largest <= system_size) {
+		largest *= 2;
+	} // while
+
+	// the multi-row kernels also take whole systems of any size
+	if(largest != system_size) {
+		sub_sizes.push_back(system_size);
+	} // if
+
+	for(size_t sub_size(largest); sub_size > 1; sub_size /= 2) {
+		sub_sizes.push_back(sub_size);
+	} // for
+
+	for(size_t s(0); s<sub_sizes.size(); ++s) {
+		const size_t sub_size(sub_sizes[s]);
+		size_t most(1);
+
+		while(2*most <= sub_size) {
+			most *= 2;
+		} // while
+
+		// a single item is thomas_kernel
+		for(size_t items(most); items > 0; items /= 2) {
+			tuning_t shape;
+			shape.sub_size = sub_size;
+			shape.rows = sub_size/items;
+
+			if(sub_size%items != 0 ||
+				!valid_tuning(token, system_size, num_systems, shape)) {
+				continue;
+			} // if
+
+			const size_t rows(shape.rows);
+
+			for(size_t v(0); v<num_variants; ++v) {
+				for(size_t divide(0); divide<divide_modes; ++divide) {
+					// the global-memory and multi-row paths have a single
+					// kernel variant
+					if((rows > 1 || global_levels(token, sub_size) > 0) &&
+						(v > 0 || divide > 0)) {
+						continue;
+					} // if
+
+					tuning_t candidate;
+					candidate.sub_size = sub_size;
+					candidate.native_divide = divide == 1;
+					candidate.variant = variants[v];
+					candidate.rows = rows;
+					candidate.seconds = std::numeric_limits<double>::max();
+
+					// the first solve builds kernels and warms up the device
+					if(solve(token, candidate, system_size, num_systems,
+						&a[0], &b[0], &c[0], &d[0], &x[0]) != CL_SUCCESS) {
+						continue;
+					} // if
+
+					wait_for_specializations(token);
+
+					for(size_t r(0); r<repetitions; ++r) {
+						std::chrono::high_resolution_clock::time_point start =
+							std::chrono::high_resolution_clock::now();
+
+						if(solve(token, candidate, system_size, num_systems,
+							&a[0], &b[0], &c[0], &d[0], &x[0]) != CL_SUCCESS) {
+							candidate.seconds = std::numeric_limits<double>::max();
+							break;
+						} // if
+
+						std::chrono::duration<double> elapsed =
+							std::chrono::high_resolution_clock::now() - start;
+						candidate.seconds = std::min(candidate.seconds,
+							elapsed.count());
+					} // for
+
+					message("tune: sub_size %d rows %d variant %d native_divide %d: "
+						"%e s\n", (int)candidate.sub_size, (int)candidate.rows,
+						(int)candidate.variant, (int)candidate.native_divide,
+						candidate.seconds);
+
+					if(candidate.seconds < best.seconds) {
+						best = candidate;
+					} // if
+				} // for
+			} // for
+		} // for
+	} // for
+
+	Stats::instance().pause(false);
+
+	TuningDB::instance().insert(tuning_key(token, system_size, num_systems),
+		best);
+	TuningDB::instance().save();
+
+	tuning = best;
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::tune
+
+/*----------------------------------------------------------------------------*
+ * Solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve(data_token_t token, size_t system_size,
+	size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+	real_t * x) {
+	return solve_truncated(token, system_size, num_systems, a, b, c, d, x,
+		0.0, nullptr);
+} // TriCyCL<>::solve
+
+/*----------------------------------------------------------------------------*
+ * Solve with optional truncation.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_truncated(data_token_t token, size_t system_size,
+	size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+	real_t * x, double tolerance, double * bound) {
+	if(bound != nullptr) {
+		*bound = 0.0;
+	} // if
+
+	if(x == nullptr) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	return solve_planned(token, system_size, num_systems, a, b, c, d, x,
+		tolerance, bound, nullptr);
+} // TriCyCL<>::solve_truncated
+
+/*----------------------------------------------------------------------------*
+ * Solve with residual norms.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_residual(data_token_t token, size_t system_size,
+	size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+	real_t * x, real_t * norms) {
+	// the residual is taken against the original right-hand side
+	if(norms == nullptr || x == d) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	return solve_planned(token, system_size, num_systems, a, b, c, d, x,
+		0.0, nullptr, norms);
+} // TriCyCL<>::solve_residual
+
+/*----------------------------------------------------------------------------*
+ * Solve with a tuned or planned configuration.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_planned(data_token_t token, size_t system_size,
+	size_t num_systems, real_t * a, real_t * b, real_t * c, real_t * d,
+	real_t * x, double tolerance, double * bound, real_t * norms) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(system_size == 0 || num_systems == 0 || a == nullptr ||
+		b == nullptr || c == nullptr || d == nullptr ||
+		(x == nullptr && norms == nullptr)) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	tuning_t tuning;
+
+	// tuned parameters are checked again in case the file is stale
+	if(!TuningDB::instance().find(tuning_key(token, system_size,
+		num_systems), tuning) || (tuning.sub_size != 0 &&
+		!valid_tuning(token, system_size, num_systems, tuning))) {
+		if(std::getenv("TRICYCL_AUTOTUNE") == nullptr ||
+			tune(token, system_size, num_systems, tuning) != TRICYCL_SUCCESS) {
+			tuning = plan(token, system_size, num_systems);
+		} // if
+	} // if
+
+	if(tuning.sub_size != 0) {
+		const int32_t ierr = solve(token, tuning, system_size, num_systems,
+			a, b, c, d, x, tolerance, bound, norms);
+
+		if(ierr == CL_SUCCESS) {
+			return TRICYCL_SUCCESS;
+		} // if
+
+		Stats::instance().device_failure();
+
+		if(!data(token).host_fallback) {
+			return ierr;
+		} // if
+
+		warning("Device solve failed with %s(%d), solving on the host\n",
+			error_to_string(ierr), ierr);
+	} // if
+
+	if(bound != nullptr) {
+		*bound = 0.0;
+	} // if
+
+	if(norms == nullptr) {
+		return solve_host(system_size, num_systems, a, b, c, d, x);
+	} // if
+
+	// the residual needs the solution even if the caller does not
+	std::vector<real_t> solution;
+
+	if(x == nullptr) {
+		try {
+			solution.resize(system_size*num_systems);
+		}
+		catch(std::bad_alloc &) {
+			return TRICYCL_OUT_OF_HOST_MEMORY;
+		} // try
+
+		x = &solution[0];
+	} // if
+
+	const int32_t ierr = solve_host(system_size, num_systems, a, b, c, d, x);
+
+	if(ierr == TRICYCL_SUCCESS) {
+		residual_norms_host(system_size, num_systems, a, b, c, d, x, norms);
+	} // if
+
+	return ierr;
+} // TriCyCL<>::solve_planned
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve(data_token_t token, const tuning_t & tuning,
+	size_t system_size, size_t num_systems, real_t * a, real_t * b,
+	real_t * c, real_t * d, real_t * x, double tolerance, double * bound,
+	real_t * norms) {
+	CALLER_SELF
+	int32_t ierr = 0;
+
+	/*-------------------------------------------------------------------------*
+	 * Sub-system calculations.
+	 *-------------------------------------------------------------------------*/
+	if(!valid_tuning(token, system_size, num_systems, tuning)) {
+		return CL_INVALID_WORK_GROUP_SIZE;
+	} // if
+
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	if(thomas_tuning(tuning, system_size)) {
+		return solve_thomas(token, *local, system_size, num_systems, a, b, c,
+			d, x, norms);
+	} // if
+
+	local->trim();
+
+	cl_kernel copy_kernel = local->copy_kernel;
+	cl_context context = data(token).context;
+	cl_command_queue queue = local->queue;
+
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	Stats::time_point_t phase_start;
+
+	// released on every return path
+	solve_resources_t r;
+
+	size_t sub_size(tuning.sub_size);
+	size_t sub_systems(system_size/sub_size);
+
+	// a single sub-system needs no interface system
+	const bool partitioned(sub_systems > 1);
+
+	// several rows per work-item, otherwise sub-systems too large for
+	// local memory start in global memory
+	const bool multi_row(tuning.rows > 1);
+	const size_t levels(multi_row ? 0 : global_levels(token, sub_size));
+
+	cl_kernel pcr_kernel = multi_row ? rows_kernel(*local, tuning.rows) :
+		levels > 0 ? local->strided_kernel :
+		select_pcr_kernel(token, sub_size, tuning.native_divide,
+		tuning.variant);
+
+	if(pcr_kernel == NULL) {
+		return CL_INVALID_KERNEL;
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Setup interface system.
+	 *-------------------------------------------------------------------------*/
+	size_t interface_size(partitioned ? 2*sub_systems*num_systems : 0);
+	size_t interface_iterations(iterations(interface_size));
+	size_t interface_systems(1);
+	cl_kernel interface_kernel = nullptr;
+	bool truncated(false);
+
+	if(partitioned) {
+		phase_start = Stats::now();
+
+		try {
+			r.interface = create_interface_system(system_size,
+				num_systems, sub_size, sub_systems, a, b, c, d);
+		}
+		catch(std::bad_alloc &) {
+			return CL_OUT_OF_HOST_MEMORY;
+		} // try
+
+		// the approximate interface replaces the interface solve
+		if(tolerance > 0.0 && levels == 0 && !multi_row) {
+			const double rho = truncate_interface(*r.interface,
+				system_size*num_systems, a, b, c);
+
+			truncated = rho <= tolerance;
+
+			if(truncated && bound != nullptr) {
+				*bound = rho;
+			} // if
+		} // if
+
+		stats.phase(TRICYCL_PHASE_INTERFACE, phase_start, Stats::now());
+
+		if(truncated) {
+			pcr_kernel = local->truncated_kernel;
+		}
+		else {
+			interface_kernel = select_pcr_kernel(token, interface_size,
+				tuning.native_divide, tuning.variant);
+
+			if(interface_kernel == NULL) {
+				return CL_INVALID_KERNEL;
+			} // if
+		} // if
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Create interface buffers.
+	 *-------------------------------------------------------------------------*/
+	cl_mem_flags is_flags = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
+	cl_mem & d_ia = r.mem[0];
+	cl_mem & d_ib = r.mem[1];
+	cl_mem & d_ic = r.mem[2];
+	cl_mem & d_id = r.mem[3];
+	cl_mem & d_ix = r.mem[4];
+	cl_mem & d_a = r.mem[5];
+	cl_mem & d_b = r.mem[6];
+	cl_mem & d_c = r.mem[7];
+	cl_mem & d_d = r.mem[8];
+	cl_mem & d_x = r.mem[9];
+	const Stats::time_point_t upload_start = Stats::now();
+
+	if(truncated) {
+		ierr = create_buffer(context, is_flags,
+			interface_size*sizeof(real_t), d_ix, r.interface->x);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+	}
+	else if(partitioned) {
+		ierr = 0;
+		ierr |= create_buffer(context, is_flags,
+			interface_size*sizeof(real_t), d_ia, r.interface->a);
+		ierr |= create_buffer(context, is_flags,
+			interface_size*sizeof(real_t), d_ib, r.interface->b);
+		ierr |= create_buffer(context, is_flags,
+			interface_size*sizeof(real_t), d_ic, r.interface->c);
+		ierr |= create_buffer(context, is_flags,
+			interface_size*sizeof(real_t), d_id, r.interface->d);
+		ierr |= create_buffer(context, CL_MEM_WRITE_ONLY,
+			interface_size*sizeof(real_t), d_ix, NULL);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Create system buffers.
+	 *-------------------------------------------------------------------------*/
+	size_t full_size(system_size*num_systems);
+
+	ierr = 0;
+	ierr |= create_buffer(context, CL_MEM_READ_WRITE,
+		full_size*sizeof(real_t), d_a, NULL);
+	ierr |= create_buffer(context, CL_MEM_READ_WRITE,
+		full_size*sizeof(real_t), d_b, NULL);
+	ierr |= create_buffer(context, CL_MEM_READ_WRITE,
+		full_size*sizeof(real_t), d_c, NULL);
+	ierr |= create_buffer(context, CL_MEM_READ_WRITE,
+		full_size*sizeof(real_t), d_d, NULL);
+
+	// each work group reads its rows of d before it writes them in x
+	const bool in_place(x == d);
+
+	if(!in_place) {
+		ierr |= create_buffer(context, CL_MEM_WRITE_ONLY,
+			full_size*sizeof(real_t), d_x, NULL);
+	} // if
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	cl_mem d_out = in_place ? d_d : d_x;
+
+	// ping-pong buffers for the global-memory levels
+	for(size_t i(10); i<14 && levels > 0; ++i) {
+		ierr |= create_buffer(context, CL_MEM_READ_WRITE,
+			full_size*sizeof(real_t), r.mem[i], NULL);
+	} // for
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	size_t offset(0);
+	size_t global_size(interface_size);
+	size_t local_size(interface_size);
+	cl_event * events = r.events;
+	Stats::time_point_t interface_start;
+
+	if(partitioned && !truncated) {
+		/*----------------------------------------------------------------------*
+		 * Set interface arguments.
+		 *----------------------------------------------------------------------*/
+		ierr = 0;
+		ierr |= clSetKernelArg(interface_kernel, 0, sizeof(cl_mem), &d_ia);
+		ierr |= clSetKernelArg(interface_kernel, 1, sizeof(cl_mem), &d_ib);
+		ierr |= clSetKernelArg(interface_kernel, 2, sizeof(cl_mem), &d_ic);
+		ierr |= clSetKernelArg(interface_kernel, 3, sizeof(cl_mem), &d_id);
+		ierr |= clSetKernelArg(interface_kernel, 4, sizeof(cl_mem), &d_ix);
+		ierr |= clSetKernelArg(interface_kernel, 5,
+			pcr_local_memory(interface_size), NULL);
+		ierr |= clSetKernelArg(interface_kernel, 6, sizeof(int32_t),
+			&interface_size);
+		ierr |= clSetKernelArg(interface_kernel, 7, sizeof(int32_t),
+			&interface_systems);
+		ierr |= clSetKernelArg(interface_kernel, 8, sizeof(int32_t),
+			&interface_iterations);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		/*----------------------------------------------------------------------*
+		 * Set copy arguments.
+		 *----------------------------------------------------------------------*/
+		ierr = 0;
+		ierr |= clSetKernelArg(copy_kernel, 0, sizeof(cl_mem), &d_a);
+		ierr |= clSetKernelArg(copy_kernel, 1, sizeof(cl_mem), &d_b);
+		ierr |= clSetKernelArg(copy_kernel, 2, sizeof(cl_mem), &d_c);
+		ierr |= clSetKernelArg(copy_kernel, 3, sizeof(cl_mem), &d_d);
+		ierr |= clSetKernelArg(copy_kernel, 4, sizeof(cl_mem), &d_ix);
+		ierr |= clSetKernelArg(copy_kernel, 5, sizeof(int32_t), &system_size);
+		ierr |= clSetKernelArg(copy_kernel, 6, sizeof(int32_t), &sub_size);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		/*----------------------------------------------------------------------*
+		 * Solve interface system.
+		 *----------------------------------------------------------------------*/
+		interface_start = Stats::now();
+		ierr = clEnqueueNDRangeKernel(queue, interface_kernel, 1, &offset,
+			&global_size, &local_size, 0, NULL, &events[4]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve", ierr);
+		} // if
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Begin writing full system to device.
+	 *-------------------------------------------------------------------------*/
+	ierr = 0;
+	ierr |= clEnqueueWriteBuffer(queue, d_a, 0, offset,
+		full_size*sizeof(real_t), a, 0, NULL, &events[0]);
+	ierr |= clEnqueueWriteBuffer(queue, d_b, 0, offset,
+		full_size*sizeof(real_t), b, 0, NULL, &events[1]);
+	ierr |= clEnqueueWriteBuffer(queue, d_c, 0, offset,
+		full_size*sizeof(real_t), c, 0, NULL, &events[2]);
+	ierr |= clEnqueueWriteBuffer(queue, d_d, 0, offset,
+		full_size*sizeof(real_t), d, 0, NULL, &events[3]);
+	
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueWriteBuffer, ierr, ierr);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Block for interface solve kernel.
+	 *-------------------------------------------------------------------------*/
+	if(partitioned && !truncated) {
+		ierr = clWaitForEvents(1, &events[4]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clWaitForEvents, ierr, ierr);
+		} // if
+
+		stats.phase(TRICYCL_PHASE_INTERFACE_PCR, interface_start,
+			Stats::now(), 1, &events[4]);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Set full system arguments.
+	 *-------------------------------------------------------------------------*/
+	size_t sub_iterations(iterations((sub_size >> levels)/tuning.rows));
+	ierr = 0;
+
+	// the global-memory path sets its arguments at launch
+	if(levels == 0) {
+		ierr |= clSetKernelArg(pcr_kernel, 0, sizeof(cl_mem), &d_a);
+		ierr |= clSetKernelArg(pcr_kernel, 1, sizeof(cl_mem), &d_b);
+		ierr |= clSetKernelArg(pcr_kernel, 2, sizeof(cl_mem), &d_c);
+		ierr |= clSetKernelArg(pcr_kernel, 3, sizeof(cl_mem), &d_d);
+		ierr |= clSetKernelArg(pcr_kernel, 4, sizeof(cl_mem), &d_out);
+
+		if(truncated) {
+			ierr |= clSetKernelArg(pcr_kernel, 5, sizeof(cl_mem), &d_ix);
+			ierr |= clSetKernelArg(pcr_kernel, 6, pcr_local_memory(sub_size),
+				NULL);
+			ierr |= clSetKernelArg(pcr_kernel, 7, sizeof(int32_t), &sub_size);
+			ierr |= clSetKernelArg(pcr_kernel, 8, sizeof(int32_t),
+				&sub_iterations);
+		}
+		else if(multi_row) {
+			ierr |= clSetKernelArg(pcr_kernel, 5,
+				pcr_rows_local_memory(sub_size/tuning.rows), NULL);
+			ierr |= clSetKernelArg(pcr_kernel, 6, sizeof(int32_t), &sub_size);
+			ierr |= clSetKernelArg(pcr_kernel, 7, sizeof(int32_t), &tuning.rows);
+			ierr |= clSetKernelArg(pcr_kernel, 8, sizeof(int32_t),
+				&sub_iterations);
+		}
+		else {
+			ierr |= clSetKernelArg(pcr_kernel, 5, pcr_local_memory(sub_size),
+				NULL);
+			ierr |= clSetKernelArg(pcr_kernel, 6, sizeof(int32_t), &sub_size);
+			ierr |= clSetKernelArg(pcr_kernel, 7, sizeof(int32_t), &sub_systems);
+			ierr |= clSetKernelArg(pcr_kernel, 8, sizeof(int32_t),
+				&sub_iterations);
+		} // if
+	} // if
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Block for full system write.
+	 *-------------------------------------------------------------------------*/
+	ierr = clWaitForEvents(4, events);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	stats.phase(TRICYCL_PHASE_UPLOAD, upload_start, Stats::now(), 4, events);
+
+	/*-------------------------------------------------------------------------*
+	 * The uncouple kernel, the global-memory levels and pcr_fused_kernel
+	 * overwrite the coefficients, so the residual needs a device copy of
+	 * them.
+	 *-------------------------------------------------------------------------*/
+	const bool keep(norms != nullptr &&
+		(partitioned || levels > 0 || tuning.rows > pcr_max_rows));
+	cl_mem originals[4] = { d_a, d_b, d_c, d_d };
+
+	if(keep) {
+		phase_start = Stats::now();
+
+		for(size_t i(0); i<4; ++i) {
+			ierr = create_buffer(context, CL_MEM_READ_ONLY,
+				full_size*sizeof(real_t), r.mem[14+i], NULL);
+
+			if(ierr != CL_SUCCESS) {
+				return ierr;
+			} // if
+
+			ierr = clEnqueueCopyBuffer(queue, originals[i], r.mem[14+i], 0, 0,
+				full_size*sizeof(real_t), 0, NULL, &events[8+i]);
+
+			if(ierr != CL_SUCCESS) {
+				CL_RETURNerr(clEnqueueCopyBuffer, ierr, ierr);
+			} // if
+
+			originals[i] = r.mem[14+i];
+		} // for
+
+		ierr = clWaitForEvents(4, &events[8]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clWaitForEvents, ierr, ierr);
+		} // if
+
+		stats.phase(TRICYCL_PHASE_RESIDUAL, phase_start, Stats::now(), 4,
+			&events[8]);
+	} // if
+
+	if(partitioned && !truncated) {
+		/*----------------------------------------------------------------------*
+		 * Copy interface results into full system.
+		 *----------------------------------------------------------------------*/
+		global_size = interface_size;
+		local_size = interface_size/num_systems;
+
+		phase_start = Stats::now();
+		ierr = clEnqueueNDRangeKernel(queue, copy_kernel, 1, &offset,
+			&global_size, &local_size, 0, NULL, &events[5]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve", ierr);
+		} // if
+
+		/*----------------------------------------------------------------------*
+		 * Block for copy operation.
+		 *----------------------------------------------------------------------*/
+		ierr = clWaitForEvents(1, &events[5]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clWaitForEvents, ierr, ierr);
+		} // if
+
+		stats.phase(TRICYCL_PHASE_UNCOUPLE, phase_start, Stats::now(),
+			1, &events[5]);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Solve full system.
+	 *-------------------------------------------------------------------------*/
+	global_size = full_size/tuning.rows;
+	local_size = sub_size/tuning.rows;
+
+	phase_start = Stats::now();
+
+	if(levels > 0) {
+		ierr = enqueue_global_pcr(*local, queue, r, d_out, sub_size, levels,
+			full_size);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+	}
+	else {
+		ierr = clEnqueueNDRangeKernel(queue, pcr_kernel, 1, &offset,
+			&global_size, &local_size, 0, NULL, &events[6]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve", ierr);
+		} // if
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Block for full system solve kernel.
+	 *-------------------------------------------------------------------------*/
+	ierr = clWaitForEvents(1, &events[6]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	std::vector<cl_event> pcr_events(r.level_events);
+	pcr_events.push_back(events[6]);
+	stats.phase(TRICYCL_PHASE_PCR, phase_start, Stats::now(),
+		pcr_events.size(), &pcr_events[0]);
+
+	/*-------------------------------------------------------------------------*
+	 * Residual norms.
+	 *-------------------------------------------------------------------------*/
+	if(norms != nullptr) {
+		phase_start = Stats::now();
+		ierr = residual_norms(token, *local, queue, r, originals[0],
+			originals[1], originals[2], originals[3], d_out, system_size,
+			num_systems, norms);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+
+		stats.phase(TRICYCL_PHASE_RESIDUAL, phase_start, Stats::now(), 2,
+			&events[12]);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Read full system solution.
+	 *-------------------------------------------------------------------------*/
+	if(x != nullptr) {
+		phase_start = Stats::now();
+		ierr = clEnqueueReadBuffer(queue, d_out, 1, offset,
+			system_size*num_systems*sizeof(real_t), x, 0, NULL, &events[7]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+		} // if
+
+		stats.phase(TRICYCL_PHASE_READBACK, phase_start, Stats::now(),
+			1, &events[7]);
+	} // if
+
+	stats.bytes((4*full_size + (truncated ? 1 : 4)*interface_size)*
+		sizeof(real_t), (x != nullptr ? full_size : 0)*sizeof(real_t) +
+		(norms != nullptr ? 2*num_systems : 0)*sizeof(real_t));
+	stats.solve(solve_start, Stats::now(), system_size, num_systems,
+		sub_size, sub_iterations, interface_size, interface_iterations);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::solve
+
+/*----------------------------------------------------------------------------*
+ * Device residual norms.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::residual_norms(data_token_t token,
+	thread_data_t & local, cl_command_queue queue, solve_resources_t & r,
+	cl_mem d_a, cl_mem d_b, cl_mem d_c, cl_mem d_d, cl_mem d_x,
+	size_t system_size, size_t num_systems, real_t * norms) {
+	CALLER_SELF
+	cl_kernel kernel = local.residual_kernel;
+	cl_mem & d_norms = r.mem[18];
+	int32_t ierr = 0;
+
+	ierr = create_buffer(data(token).context, CL_MEM_WRITE_ONLY,
+		2*num_systems*sizeof(real_t), d_norms, NULL);
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	// a power-of-two work group per system for the tree reduction, within
+	// the limit of this kernel rather than that of the PCR kernels
+	size_t kernel_limit(0);
+
+	ierr = clGetKernelWorkGroupInfo(kernel, data(token).id,
+		CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernel_limit, NULL);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clGetKernelWorkGroupInfo, ierr, ierr);
+	} // if
+
+	const size_t limit(std::min(system_size, kernel_limit));
+	size_t local_size(1);
+
+	while(2*local_size <= limit) {
+		local_size *= 2;
+	} // while
+
+	ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_a);
+	ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_b);
+	ierr |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_c);
+	ierr |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_d);
+	ierr |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &d_x);
+	ierr |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &d_norms);
+	ierr |= clSetKernelArg(kernel, 6, 2*local_size*sizeof(real_t), NULL);
+	ierr |= clSetKernelArg(kernel, 7, sizeof(int32_t), &system_size);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	size_t offset(0);
+	size_t global_size(local_size*num_systems);
+
+	ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+		&local_size, 0, NULL, &r.events[12]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "residual_norms", ierr);
+	} // if
+
+	ierr = clEnqueueReadBuffer(queue, d_norms, 1, 0,
+		2*num_systems*sizeof(real_t), norms, 1, &r.events[12], &r.events[13]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+	} // if
+
+	global_norms(num_systems, norms);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::residual_norms
+
+/*----------------------------------------------------------------------------*
+ * Enqueue the one-work-item-per-system solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::enqueue_thomas(data_token_t token, thread_data_t & local,
+	cl_command_queue queue, cl_mem d_a, cl_mem d_b, cl_mem d_c, cl_mem d_d,
+	cl_mem d_cp, cl_mem d_x, size_t system_size, size_t num_systems,
+	cl_event * event) {
+	CALLER_SELF
+	cl_kernel kernel = local.thomas_kernel;
+	size_t local_size(thomas_group_size(token));
+	int32_t ierr = 0;
+
+	if(local_size == 0) {
+		return CL_INVALID_WORK_GROUP_SIZE;
+	} // if
+
+	ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_a);
+	ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_b);
+	ierr |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_c);
+	ierr |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_d);
+	ierr |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &d_cp);
+	ierr |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &d_x);
+	ierr |= clSetKernelArg(kernel, 6, thomas_local_memory(local_size), NULL);
+	ierr |= clSetKernelArg(kernel, 7, sizeof(int32_t), &system_size);
+	ierr |= clSetKernelArg(kernel, 8, sizeof(int32_t), &num_systems);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	// the last group is padded with idle work-items
+	size_t offset(0);
+	size_t global_size(local_size*((num_systems + local_size-1)/local_size));
+
+	ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+		&local_size, 0, NULL, event);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "thomas_kernel", ierr);
+	} // if
+
+	return CL_SUCCESS;
+} // TriCyCL<>::enqueue_thomas
+
+/*----------------------------------------------------------------------------*
+ * One-work-item-per-system solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_thomas(data_token_t token, thread_data_t & local,
+	size_t system_size, size_t num_systems, real_t * a, real_t * b,
+	real_t * c, real_t * d, real_t * x, real_t * norms) {
+	CALLER_SELF
+	cl_context context = data(token).context;
+	cl_command_queue queue = local.queue;
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	const size_t bytes(system_size*num_systems*sizeof(real_t));
+	int32_t ierr = 0;
+	solve_resources_t r;
+
+	/*-------------------------------------------------------------------------*
+	 * In place, c' overwrites c and the solution overwrites d (four
+	 * buffers).  Otherwise a..d stay intact for the residual, and c' goes
+	 * to a scratch buffer.
+	 *-------------------------------------------------------------------------*/
+	const bool in_place(x == d);
+	real_t * arrays[4] = { a, b, c, d };
+
+	for(size_t i(0); i<4; ++i) {
+		ierr |= create_buffer(context, (in_place && i >= 2 ?
+			CL_MEM_READ_WRITE : CL_MEM_READ_ONLY) | CL_MEM_COPY_HOST_PTR,
+			bytes, r.mem[i], arrays[i]);
+	} // for
+
+	for(size_t i(4); i<6 && !in_place; ++i) {
+		ierr |= create_buffer(context, CL_MEM_READ_WRITE, bytes, r.mem[i],
+			NULL);
+	} // for
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	cl_mem d_cp = in_place ? r.mem[2] : r.mem[4];
+	cl_mem d_out = in_place ? r.mem[3] : r.mem[5];
+
+	stats.phase(TRICYCL_PHASE_UPLOAD, solve_start, Stats::now());
+
+	Stats::time_point_t phase_start = Stats::now();
+
+	ierr = enqueue_thomas(token, local, queue, r.mem[0], r.mem[1], r.mem[2],
+		r.mem[3], d_cp, d_out, system_size, num_systems, &r.events[6]);
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Residual norms.
+	 *-------------------------------------------------------------------------*/
+	if(norms != nullptr) {
+		ierr = clWaitForEvents(1, &r.events[6]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clWaitForEvents, ierr, ierr);
+		} // if
+
+		stats.phase(TRICYCL_PHASE_PCR, phase_start, Stats::now(), 1,
+			&r.events[6]);
+
+		phase_start = Stats::now();
+		ierr = residual_norms(token, local, queue, r, r.mem[0], r.mem[1],
+			r.mem[2], r.mem[3], d_out, system_size, num_systems, norms);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+
+		stats.phase(TRICYCL_PHASE_RESIDUAL, phase_start, Stats::now(), 2,
+			&r.events[12]);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Read back.
+	 *-------------------------------------------------------------------------*/
+	if(x != nullptr) {
+		ierr = clEnqueueReadBuffer(queue, d_out, 0, 0, bytes, x, 1,
+			&r.events[6], &r.events[7]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+		} // if
+
+		ierr = clWaitForEvents(1, &r.events[7]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clWaitForEvents, ierr, ierr);
+		} // if
+	} // if
+
+	const Stats::time_point_t end = Stats::now();
+
+	// without norms the host waits once, for the readback
+	if(norms == nullptr) {
+		stats.phase(TRICYCL_PHASE_PCR, phase_start, end, 1, &r.events[6]);
+	} // if
+
+	if(x != nullptr) {
+		stats.phase(TRICYCL_PHASE_READBACK, end, end, 1, &r.events[7]);
+	} // if
+
+	stats.bytes(4*bytes, (x != nullptr ? bytes : 0) +
+		(norms != nullptr ? 2*num_systems : 0)*sizeof(real_t));
+	stats.solve(solve_start, end, system_size, num_systems, system_size, 0,
+		0, 0);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::solve_thomas
+
+/*----------------------------------------------------------------------------*
+ * Global-memory PCR.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::enqueue_global_pcr(thread_data_t & local,
+	cl_command_queue queue, solve_resources_t & r, cl_mem d_out,
+	size_t sub_size, size_t levels, size_t full_size) {
+	CALLER_SELF
+	cl_kernel kernel = local.global_kernel;
+	cl_mem * in = &r.mem[5];
+	cl_mem * out = &r.mem[10];
+	size_t offset(0);
+	size_t local_size(sub_size >> levels);
+	int32_t ierr = 0;
+
+	for(size_t level(0); level<levels; ++level) {
+		const int32_t delta(1 << level);
+
+		ierr = 0;
+
+		for(size_t i(0); i<4; ++i) {
+			ierr |= clSetKernelArg(kernel, i, sizeof(cl_mem), &in[i]);
+			ierr |= clSetKernelArg(kernel, 4+i, sizeof(cl_mem), &out[i]);
+		} // for
+
+		ierr |= clSetKernelArg(kernel, 8, sizeof(int32_t), &sub_size);
+		ierr |= clSetKernelArg(kernel, 9, sizeof(int32_t), &delta);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		// each level waits for the previous one, even on out-of-order queues
+		const cl_uint num_wait = r.level_events.empty() ? 0 : 1;
+		const cl_event * wait = num_wait ? &r.level_events.back() : NULL;
+		cl_event event;
+
+		ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &full_size,
+			&local_size, num_wait, wait, &event);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "pcr_global_kernel",
+				ierr);
+		} // if
+
+		r.level_events.push_back(event);
+		std::swap(in, out);
+	} // for
+
+	/*-------------------------------------------------------------------------*
+	 * Rows i, i+2^levels, ... of each sub-system are now independent, which
+	 * is the strided line layout with lines0 = 2^levels.
+	 *-------------------------------------------------------------------------*/
+	const int32_t system_size(sub_size >> levels);
+	const int32_t num_iterations(iterations(system_size));
+	const cl_long stride(cl_long(1) << levels);
+	const cl_long lines0(stride);
+	const cl_long stride0(1);
+	const cl_long stride1(sub_size);
+
+	ierr = 0;
+
+	for(size_t i(0); i<4; ++i) {
+		ierr |= clSetKernelArg(local.strided_kernel, i, sizeof(cl_mem), &in[i]);
+	} // for
+
+	ierr |= clSetKernelArg(local.strided_kernel, 4, sizeof(cl_mem), &d_out);
+	ierr |= clSetKernelArg(local.strided_kernel, 5,
+		pcr_local_memory(system_size), NULL);
+	ierr |= clSetKernelArg(local.strided_kernel, 6, sizeof(int32_t),
+		&system_size);
+	ierr |= clSetKernelArg(local.strided_kernel, 7, sizeof(int32_t),
+		&num_iterations);
+	ierr |= clSetKernelArg(local.strided_kernel, 8, sizeof(cl_long), &stride);
+	ierr |= clSetKernelArg(local.strided_kernel, 9, sizeof(cl_long), &lines0);
+	ierr |= clSetKernelArg(local.strided_kernel, 10, sizeof(cl_long),
+		&stride0);
+	ierr |= clSetKernelArg(local.strided_kernel, 11, sizeof(cl_long),
+		&stride1);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	ierr = clEnqueueNDRangeKernel(queue, local.strided_kernel, 1, &offset,
+		&full_size, &local_size, 1, &r.level_events.back(), &r.events[6]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "pcr_strided_kernel",
+			ierr);
+	} // if
+
+	return CL_SUCCESS;
+} // TriCyCL<>::enqueue_global_pcr
+
+/*----------------------------------------------------------------------------*
+ * Host Thomas solve of one strided system.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+void
+TriCyCL<real_t>::thomas_host(size_t system_size, size_t stride,
+	const real_t * a, const real_t * b, const real_t * c, const real_t * d,
+	real_t * x, real_t * w) {
+	// forward elimination
+	w[0] = c[0]/b[0];
+	x[0] = d[0]/b[0];
+
+	for(size_t i(1); i<system_size; ++i) {
+		const size_t k = i*stride;
+		const real_t r = 1.0/(b[k] - a[k]*w[i-1]);
+		w[i] = c[k]*r;
+		x[k] = (d[k] - a[k]*x[k-stride])*r;
+	} // for
+
+	// back substitution
+	for(size_t i(system_size-1); i>0; --i) {
+		x[(i-1)*stride] -= w[i-1]*x[i*stride];
+	} // for
+} // TriCyCL<>::thomas_host
+
+/*----------------------------------------------------------------------------*
+ * Host solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_host(size_t system_size, size_t num_systems,
+	const real_t * a, const real_t * b, const real_t * c, const real_t * d,
+	real_t * x) {
+	const Stats::time_point_t start = Stats::now();
+	std::vector<real_t> w;
+
+	try {
+		w.resize(system_size);
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	for(size_t s(0); s<num_systems; ++s) {
+		const size_t o = s*system_size;
+
+		thomas_host(system_size, 1, a + o, b + o, c + o, d + o, x + o, &w[0]);
+	} // for
+
+	const Stats::time_point_t end = Stats::now();
+	Stats & stats = Stats::instance();
+
+	stats.phase(TRICYCL_PHASE_HOST, start, end);
+	stats.solve(start, end, system_size, num_systems, 0, 0, 0, 0);
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::solve_host
+
+/*----------------------------------------------------------------------------*
+ * Host residual norms.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+void
+TriCyCL<real_t>::residual_norms_host(size_t system_size,
+	size_t num_systems, const real_t * a, const real_t * b, const real_t * c,
+	const real_t * d, const real_t * x, real_t * norms) {
+	for(size_t s(0); s<num_systems; ++s) {
+		const size_t soff = s*system_size;
+		real_t sum(0.0);
+		real_t peak(0.0);
+
+		for(size_t i(0); i<system_size; ++i) {
+			real_t r = d[soff+i] - b[soff+i]*x[soff+i];
+
+			if(i > 0) {
+				r -= a[soff+i]*x[soff+i-1];
+			} // if
+
+			if(i < system_size-1) {
+				r -= c[soff+i]*x[soff+i+1];
+			} // if
+
+			sum += r*r;
+			peak = std::max(peak, std::abs(r));
+		} // for
+
+		norms[2*s] = std::sqrt(sum);
+		norms[2*s+1] = peak;
+	} // for
+
+	global_norms(num_systems, norms);
+} // TriCyCL<>::residual_norms_host
+
+/*----------------------------------------------------------------------------*
+ * Global residual norms from the per-system norms.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+void
+TriCyCL<real_t>::global_norms(size_t num_systems, real_t * norms) {
+	real_t sum(0.0);
+	real_t peak(0.0);
+
+	for(size_t s(0); s<num_systems; ++s) {
+		sum += norms[2*s]*norms[2*s];
+		peak = std::max(peak, norms[2*s+1]);
+	} // for
+
+	norms[2*num_systems] = std::sqrt(sum);
+	norms[2*num_systems+1] = peak;
+} // TriCyCL<>::global_norms
+
+/*----------------------------------------------------------------------------*
+ * Grid solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_grid(data_token_t token, const tricycl_grid_t & grid,
+	real_t * a, real_t * b, real_t * c, real_t * d, real_t * x) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(grid.axis < 0 || grid.axis > 2 || a == nullptr || b == nullptr ||
+		c == nullptr || d == nullptr || x == nullptr) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	// the two remaining axes form the batch
+	const size_t axis(grid.axis);
+	const size_t axis0((axis+1)%3 < (axis+2)%3 ? (axis+1)%3 : (axis+2)%3);
+	const size_t axis1(3 - axis - axis0);
+	grid_lines_t lines;
+	size_t points(1);
+
+	lines.extent = 1;
+
+	for(size_t i(0); i<3; ++i) {
+		if(grid.dims[i] == 0) {
+			return TRICYCL_INVALID_VALUE;
+		} // if
+
+		lines.extent += (grid.dims[i]-1)*grid.strides[i];
+		points *= grid.dims[i];
+	} // for
+
+	lines.system_size = grid.dims[axis];
+	lines.stride = grid.strides[axis];
+	lines.lines0 = grid.dims[axis0];
+	lines.stride0 = grid.strides[axis0];
+	lines.stride1 = grid.strides[axis1];
+	lines.num_lines = grid.dims[axis0]*grid.dims[axis1];
+
+	// padding between lines must not be overwritten by the readback
+	lines.dense = lines.extent == points;
+
+	// lines are padded to a power of two, so any line that fits in one
+	// work group is solved on the device, longer lines on the host
+	const size_t items = padded_size(lines.system_size);
+	const tuning_t tuning = plan(token, items, lines.num_lines, false);
+
+	if(tuning.sub_size == items && items <= local_sub_size(token)) {
+		const int32_t ierr = solve_grid_device(token, lines, a, b, c, d, x);
+
+		if(ierr == CL_SUCCESS) {
+			return TRICYCL_SUCCESS;
+		} // if
+
+		Stats::instance().device_failure();
+
+		if(!data(token).host_fallback) {
+			return ierr;
+		} // if
+
+		warning("Device grid solve failed with %s(%d), solving on the host\n",
+			error_to_string(ierr), ierr);
+	} // if
+
+	return solve_grid_host(lines, a, b, c, d, x);
+} // TriCyCL<>::solve_grid
+
+#if defined(ENABLE_TRICYCL_MPI)
+/*----------------------------------------------------------------------------*
+ * Distributed solve.
+ *
+ * Each rank's chunk is one partition of the interface scheme: the rank
+ * reduces its chunk to the two interface rows per system, rank 0 gathers
+ * and solves the interface systems (2*ranks rows each), and the interface
+ * values are scattered back.  The chunk is then solved locally with its
+ * first and last rows replaced by the interface values, as uncouple does.
+ *
+ * The reduction runs on the host with create_interface_system, as it does
+ * for a partitioned solve on one device: it is one sequential pass over
+ * rows that are already in host memory, and reducing on the device would
+ * add an upload and a readback before the gather without removing the
+ * upload of the local solve.  Only the interface and local solves use
+ * the device.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_mpi(data_token_t token, MPI_Comm comm,
+	size_t local_size, size_t num_systems, real_t * a, real_t * b,
+	real_t * c, real_t * d, real_t * x) {
+	const MPI_Datatype type = TypeToOpt<real_t>::mpi_type();
+	int rank, ranks;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &ranks);
+
+	/*-------------------------------------------------------------------------*
+	 * Local reduction.  Errors, including failed allocations, are agreed
+	 * on before any rank waits on another.
+	 *-------------------------------------------------------------------------*/
+	const size_t rows(2*num_systems);
+	int32_t status(TRICYCL_SUCCESS);
+	interface_t * local = nullptr;
+	std::vector<real_t> ix;
+	std::vector<real_t> send;
+	std::vector<real_t> recv;
+	std::vector<real_t> saved;
+
+	if(token >= num_tokens_) {
+		status = TRICYCL_INVALID_TOKEN;
+	}
+	else if(local_size < 2 || num_systems == 0 || a == nullptr ||
+		b == nullptr || c == nullptr || d == nullptr || x == nullptr) {
+		status = TRICYCL_INVALID_VALUE;
+	}
+	else if(ranks > 1) {
+		try {
+			local = create_interface_system(local_size, num_systems,
+				local_size, 1, a, b, c, d);
+			ix.resize(rows);
+			send.resize(4*rows);
+			recv.resize(rank == 0 ? 4*rows*ranks : 0);
+			saved.resize(8*num_systems);
+		}
+		catch(std::bad_alloc &) {
+			status = TRICYCL_OUT_OF_HOST_MEMORY;
+		} // try
+	} // if
+
+	// every rank must have the same number of systems
+	long agreed[3] = { status, (long)num_systems, -(long)num_systems };
+	MPI_Allreduce(MPI_IN_PLACE, agreed, 3, MPI_LONG, MPI_MIN, comm);
+
+	if(agreed[0] == TRICYCL_SUCCESS && agreed[1] != -agreed[2]) {
+		agreed[0] = TRICYCL_INVALID_VALUE;
+	} // if
+
+	if(agreed[0] != TRICYCL_SUCCESS || ranks == 1) {
+		delete local;
+		return agreed[0] != TRICYCL_SUCCESS ? int32_t(agreed[0]) :
+			solve(token, local_size, num_systems, a, b, c, d, x);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Gather and solve the interface systems on rank 0.
+	 *-------------------------------------------------------------------------*/
+	const size_t interface_size(2*ranks);
+
+	std::copy(local->a, local->a + rows, send.begin());
+	std::copy(local->b, local->b + rows, send.begin() + rows);
+	std::copy(local->c, local->c + rows, send.begin() + 2*rows);
+	std::copy(local->d, local->d + rows, send.begin() + 3*rows);
+
+	delete local;
+
+	MPI_Gather(&send[0], int(4*rows), type,
+		recv.empty() ? nullptr : &recv[0], int(4*rows), type, 0, comm);
+
+	std::vector<real_t> scatter;
+
+	if(rank == 0) {
+		try {
+			// system s, row 2*p + k comes from rank p, row 2*s + k
+			interface_t global(interface_size*num_systems);
+			scatter.resize(rows*ranks);
+
+			for(size_t p(0); p<size_t(ranks); ++p) {
+				const real_t * from = &recv[p*4*rows];
+
+				for(size_t s(0); s<num_systems; ++s) {
+					for(size_t k(0); k<2; ++k) {
+						const size_t i = s*interface_size + 2*p + k;
+						const size_t j = 2*s + k;
+
+						global.a[i] = from[j];
+						global.b[i] = from[rows + j];
+						global.c[i] = from[2*rows + j];
+						global.d[i] = from[3*rows + j];
+					} // for
+				} // for
+			} // for
+
+			status = solve(token, interface_size, num_systems, global.a,
+				global.b, global.c, global.d, global.x);
+
+			for(size_t p(0); p<size_t(ranks); ++p) {
+				for(size_t s(0); s<num_systems; ++s) {
+					for(size_t k(0); k<2; ++k) {
+						scatter[p*rows + 2*s + k] =
+							global.x[s*interface_size + 2*p + k];
+					} // for
+				} // for
+			} // for
+		}
+		catch(std::bad_alloc &) {
+			status = TRICYCL_OUT_OF_HOST_MEMORY;
+		} // try
+	} // if
+
+	// the interface solve on rank 0 can fail, so agree again
+	MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT32_T, MPI_MIN, comm);
+
+	if(status != TRICYCL_SUCCESS) {
+		return status;
+	} // if
+
+	MPI_Scatter(scatter.empty() ? nullptr : &scatter[0], int(rows), type,
+		&ix[0], int(rows), type, 0, comm);
+
+	/*-------------------------------------------------------------------------*
+	 * Local solve of the uncoupled chunk.  The replaced rows are restored
+	 * afterwards (except d when the solve was in place).
+	 *-------------------------------------------------------------------------*/
+	for(size_t s(0); s<num_systems; ++s) {
+		for(size_t k(0); k<2; ++k) {
+			const size_t i = s*local_size + k*(local_size-1);
+			real_t * row = &saved[8*s + 4*k];
+
+			row[0] = a[i]; row[1] = b[i]; row[2] = c[i]; row[3] = d[i];
+
+			a[i] = 0.0;
+			b[i] = 1.0;
+			c[i] = 0.0;
+			d[i] = ix[2*s + k];
+		} // for
+	} // for
+
+	status = solve(token, local_size, num_systems, a, b, c, d, x);
+
+	for(size_t s(0); s<num_systems; ++s) {
+		for(size_t k(0); k<2; ++k) {
+			const size_t i = s*local_size + k*(local_size-1);
+			const real_t * row = &saved[8*s + 4*k];
+
+			a[i] = row[0]; b[i] = row[1]; c[i] = row[2];
+
+			if(x != d) {
+				d[i] = row[3];
+			} // if
+		} // for
+	} // for
+
+	return status;
+} // TriCyCL<>::solve_mpi
+#endif
+
+/*----------------------------------------------------------------------------*
+ * Device grid solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_grid_device(data_token_t token,
+	const grid_lines_t & lines, real_t * a, real_t * b, real_t * c,
+	real_t * d, real_t * x) {
+	CALLER_SELF
+	int32_t ierr = 0;
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	cl_context context = data(token).context;
+	cl_command_queue queue = local->queue;
+	cl_kernel kernel = local->strided_kernel;
+
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	Stats::time_point_t phase_start = solve_start;
+	solve_resources_t r;
+
+	const size_t bytes(lines.extent*sizeof(real_t));
+	const cl_mem_flags x_flags = lines.dense ? CL_MEM_WRITE_ONLY :
+		CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR;
+
+	ierr = 0;
+	ierr |= create_buffer(context, CL_MEM_READ_ONLY, bytes, r.mem[0], NULL);
+	ierr |= create_buffer(context, CL_MEM_READ_ONLY, bytes, r.mem[1], NULL);
+	ierr |= create_buffer(context, CL_MEM_READ_ONLY, bytes, r.mem[2], NULL);
+	ierr |= create_buffer(context, CL_MEM_READ_ONLY, bytes, r.mem[3], NULL);
+	ierr |= create_buffer(context, x_flags, bytes, r.mem[4],
+		lines.dense ? NULL : x);
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	ierr = 0;
+	ierr |= clEnqueueWriteBuffer(queue, r.mem[0], 0, 0, bytes, a, 0, NULL,
+		&r.events[0]);
+	ierr |= clEnqueueWriteBuffer(queue, r.mem[1], 0, 0, bytes, b, 0, NULL,
+		&r.events[1]);
+	ierr |= clEnqueueWriteBuffer(queue, r.mem[2], 0, 0, bytes, c, 0, NULL,
+		&r.events[2]);
+	ierr |= clEnqueueWriteBuffer(queue, r.mem[3], 0, 0, bytes, d, 0, NULL,
+		&r.events[3]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueWriteBuffer, ierr, ierr);
+	} // if
+
+	const size_t items(padded_size(lines.system_size));
+	int32_t system_size(lines.system_size);
+	int32_t num_iterations(iterations(items));
+	cl_long stride(lines.stride);
+	cl_long lines0(lines.lines0);
+	cl_long stride0(lines.stride0);
+	cl_long stride1(lines.stride1);
+
+	ierr = 0;
+	ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &r.mem[0]);
+	ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &r.mem[1]);
+	ierr |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &r.mem[2]);
+	ierr |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &r.mem[3]);
+	ierr |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &r.mem[4]);
+	ierr |= clSetKernelArg(kernel, 5, pcr_local_memory(items), NULL);
+	ierr |= clSetKernelArg(kernel, 6, sizeof(int32_t), &system_size);
+	ierr |= clSetKernelArg(kernel, 7, sizeof(int32_t), &num_iterations);
+	ierr |= clSetKernelArg(kernel, 8, sizeof(cl_long), &stride);
+	ierr |= clSetKernelArg(kernel, 9, sizeof(cl_long), &lines0);
+	ierr |= clSetKernelArg(kernel, 10, sizeof(cl_long), &stride0);
+	ierr |= clSetKernelArg(kernel, 11, sizeof(cl_long), &stride1);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	ierr = clWaitForEvents(4, r.events);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	stats.phase(TRICYCL_PHASE_UPLOAD, phase_start, Stats::now(), 4, r.events);
+
+	size_t offset(0);
+	size_t global_size(items*lines.num_lines);
+	size_t local_size(items);
+
+	phase_start = Stats::now();
+	ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+		&local_size, 0, NULL, &r.events[4]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve_grid", ierr);
+	} // if
+
+	ierr = clWaitForEvents(1, &r.events[4]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	stats.phase(TRICYCL_PHASE_PCR, phase_start, Stats::now(), 1,
+		&r.events[4]);
+
+	phase_start = Stats::now();
+	ierr = clEnqueueReadBuffer(queue, r.mem[4], 1, 0, bytes, x, 0, NULL,
+		&r.events[5]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+	} // if
+
+	stats.phase(TRICYCL_PHASE_READBACK, phase_start, Stats::now(), 1,
+		&r.events[5]);
+
+	stats.bytes((lines.dense ? 4 : 5)*bytes, bytes);
+	stats.solve(solve_start, Stats::now(), lines.system_size,
+		lines.num_lines, items, num_iterations, 0, 0);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::solve_grid_device
+
+/*----------------------------------------------------------------------------*
+ * Host grid solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_grid_host(const grid_lines_t & lines,
+	const real_t * a, const real_t * b, const real_t * c, const real_t * d,
+	real_t * x) {
+	const Stats::time_point_t start = Stats::now();
+	const size_t n(lines.system_size);
+	std::vector<real_t> w;
+
+	try {
+		w.resize(n);
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	for(size_t l(0); l<lines.num_lines; ++l) {
+		const size_t o = (l % lines.lines0)*lines.stride0 +
+			(l / lines.lines0)*lines.stride1;
+
+		thomas_host(n, lines.stride, a + o, b + o, c + o, d + o, x + o,
+			&w[0]);
+	} // for
+
+	const Stats::time_point_t end = Stats::now();
+	Stats & stats = Stats::instance();
+
+	stats.phase(TRICYCL_PHASE_HOST, start, end);
+	stats.solve(start, end, n, lines.num_lines, 0, 0, 0, 0);
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::solve_grid_host
+
+/*----------------------------------------------------------------------------*
+ * Ragged solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_ragged(data_token_t token, size_t num_systems,
+	const size_t * offsets, real_t * a, real_t * b, real_t * c, real_t * d,
+	real_t * x) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(num_systems == 0 || offsets == nullptr || offsets[0] != 0 ||
+		a == nullptr || b == nullptr || c == nullptr || d == nullptr ||
+		x == nullptr) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	for(size_t s(0); s<num_systems; ++s) {
+		if(offsets[s+1] < offsets[s]) {
+			return TRICYCL_INVALID_VALUE;
+		} // if
+	} // for
+
+	solver_data_t & solver_data = data(token);
+	const cost_model_t & model = solver_data.cost_model;
+	const double rows(offsets[num_systems]);
+
+	// the planner weighs a single direct device solve against the host
+	if(!solver_data.planner ||
+		model.device_latency + model.device_row*rows < model.host_row*rows) {
+		const int32_t ierr = solve_ragged_device(token, num_systems, offsets,
+			a, b, c, d, x);
+
+		if(ierr == CL_SUCCESS) {
+			return TRICYCL_SUCCESS;
+		} // if
+
+		Stats::instance().device_failure();
+
+		if(!solver_data.host_fallback) {
+			return ierr;
+		} // if
+
+		warning("Device ragged solve failed with %s(%d), solving on the "
+			"host\n", error_to_string(ierr), ierr);
+	} // if
+
+	return solve_ragged_host(num_systems, offsets, a, b, c, d, x);
+} // TriCyCL<>::solve_ragged
+
+/*----------------------------------------------------------------------------*
+ * Device ragged solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_ragged_device(data_token_t token,
+	size_t num_systems, const size_t * offsets, real_t * a, real_t * b,
+	real_t * c, real_t * d, real_t * x) {
+	CALLER_SELF
+	const cl_ulong local_mem_size = data(token).device_info.local_mem_size;
+	const size_t full_size(offsets[num_systems]);
+	const size_t bytes(full_size*sizeof(real_t));
+	int32_t ierr = 0;
+
+	// the kernel indexes rows with 32-bit offsets
+	if(full_size > std::numeric_limits<uint32_t>::max()) {
+		return CL_INVALID_BUFFER_SIZE;
+	} // if
+
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	cl_context context = data(token).context;
+	cl_command_queue queue = local->queue;
+	cl_kernel kernel = local->ragged_kernel;
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	solve_resources_t r;
+
+	/*-------------------------------------------------------------------------*
+	 * Bin the systems by work-group size: the largest power of two with a
+	 * block of at least three rows per work-item, at least two.
+	 *-------------------------------------------------------------------------*/
+	size_t limit(max_sub_size(token, std::numeric_limits<size_t>::max()));
+
+	while(limit > 2 && pcr_rows_local_memory(limit) > local_mem_size) {
+		limit /= 2;
+	} // while
+
+	if(limit < 2 || pcr_rows_local_memory(limit) > local_mem_size) {
+		return CL_INVALID_WORK_GROUP_SIZE;
+	} // if
+
+	std::map<size_t, std::vector<uint32_t>> bins;
+	std::vector<uint32_t> d_offsets;
+	std::vector<uint32_t> systems;
+	size_t largest(0);
+
+	try {
+		d_offsets.assign(offsets, offsets + num_systems+1);
+		systems.reserve(num_systems);
+
+		for(size_t s(0); s<num_systems; ++s) {
+			const size_t system_size(offsets[s+1] - offsets[s]);
+			size_t items(2);
+
+			while(2*items <= std::min(limit, system_size/3)) {
+				items *= 2;
+			} // while
+
+			bins[items].push_back(s);
+			largest = std::max(largest, system_size);
+		} // for
+
+		for(typename std::map<size_t, std::vector<uint32_t>>::iterator
+			ita = bins.begin(); ita != bins.end(); ++ita) {
+			systems.insert(systems.end(), ita->second.begin(),
+				ita->second.end());
+		} // for
+	}
+	catch(std::bad_alloc &) {
+		return CL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	/*-------------------------------------------------------------------------*
+	 * Upload.
+	 *-------------------------------------------------------------------------*/
+	Stats::time_point_t phase_start = Stats::now();
+	cl_mem_flags copy_flags = CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR;
+
+	ierr = 0;
+
+	for(size_t i(0); i<4; ++i) {
+		ierr |= create_buffer(context, CL_MEM_READ_WRITE,
+			std::max(bytes, sizeof(real_t)), r.mem[i], NULL);
+	} // for
+
+	ierr |= create_buffer(context, CL_MEM_WRITE_ONLY,
+		std::max(bytes, sizeof(real_t)), r.mem[4], NULL);
+	ierr |= create_buffer(context, copy_flags,
+		d_offsets.size()*sizeof(uint32_t), r.mem[5], &d_offsets[0]);
+	ierr |= create_buffer(context, copy_flags,
+		systems.size()*sizeof(uint32_t), r.mem[6], &systems[0]);
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	// every system may be empty
+	if(full_size == 0) {
+		return CL_SUCCESS;
+	} // if
+
+	real_t * arrays[4] = { a, b, c, d };
+
+	for(size_t i(0); i<4; ++i) {
+		ierr = clEnqueueWriteBuffer(queue, r.mem[i], 0, 0, bytes, arrays[i],
+			0, NULL, &r.events[i]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clEnqueueWriteBuffer, ierr, ierr);
+		} // if
+	} // for
+
+	/*-------------------------------------------------------------------------*
+	 * One launch per bin, each waiting only for the upload.
+	 *-------------------------------------------------------------------------*/
+	ierr = 0;
+
+	for(size_t i(0); i<5; ++i) {
+		ierr |= clSetKernelArg(kernel, i, sizeof(cl_mem), &r.mem[i]);
+	} // for
+
+	ierr |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &r.mem[5]);
+	ierr |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &r.mem[6]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	int32_t first(0);
+	size_t largest_items(0);
+
+	for(typename std::map<size_t, std::vector<uint32_t>>::iterator
+		ita = bins.begin(); ita != bins.end(); ++ita) {
+		const size_t items(ita->first);
+		int32_t bin_iterations(iterations(items));
+
+		ierr = 0;
+		ierr |= clSetKernelArg(kernel, 7, pcr_rows_local_memory(items), NULL);
+		ierr |= clSetKernelArg(kernel, 8, sizeof(int32_t), &first);
+		ierr |= clSetKernelArg(kernel, 9, sizeof(int32_t), &bin_iterations);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		size_t offset(0);
+		size_t global_size(items*ita->second.size());
+		size_t local_size(items);
+		cl_event event;
+
+		ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+			&local_size, 4, r.events, &event);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve_ragged", ierr);
+		} // if
+
+		// released with the other resources
+		r.level_events.push_back(event);
+		first += ita->second.size();
+		largest_items = items;
+	} // for
+
+	/*-------------------------------------------------------------------------*
+	 * Read back after every bin, then wait once.
+	 *-------------------------------------------------------------------------*/
+	ierr = clEnqueueReadBuffer(queue, r.mem[4], 0, 0, bytes, x,
+		r.level_events.size(), &r.level_events[0], &r.events[4]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+	} // if
+
+	ierr = clWaitForEvents(1, &r.events[4]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	const Stats::time_point_t end = Stats::now();
+
+	stats.phase(TRICYCL_PHASE_UPLOAD, end, end, 4, r.events);
+	stats.phase(TRICYCL_PHASE_PCR, phase_start, end, r.level_events.size(),
+		&r.level_events[0]);
+	stats.phase(TRICYCL_PHASE_READBACK, end, end, 1, &r.events[4]);
+	stats.bytes(4*bytes + (d_offsets.size() + systems.size())*
+		sizeof(uint32_t), bytes);
+	stats.solve(solve_start, end, largest, num_systems, largest_items,
+		iterations(largest_items), 0, 0);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::solve_ragged_device
+
+/*----------------------------------------------------------------------------*
+ * Host ragged solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_ragged_host(size_t num_systems, const size_t * offsets,
+	const real_t * a, const real_t * b, const real_t * c, const real_t * d,
+	real_t * x) {
+	const Stats::time_point_t start = Stats::now();
+	std::vector<real_t> w;
+	size_t largest(0);
+
+	for(size_t s(0); s<num_systems; ++s) {
+		largest = std::max(largest, offsets[s+1] - offsets[s]);
+	} // for
+
+	try {
+		w.resize(std::max(largest, size_t(1)));
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	for(size_t s(0); s<num_systems; ++s) {
+		const size_t o(offsets[s]);
+		const size_t n(offsets[s+1] - o);
+
+		if(n > 0) {
+			thomas_host(n, 1, a + o, b + o, c + o, d + o, x + o, &w[0]);
+		} // if
+	} // for
+
+	const Stats::time_point_t end = Stats::now();
+	Stats & stats = Stats::instance();
+
+	stats.phase(TRICYCL_PHASE_HOST, start, end);
+	stats.solve(start, end, largest, num_systems, 0, 0, 0, 0);
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::solve_ragged_host
+
+/*----------------------------------------------------------------------------*
+ * Line smoothing.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::smooth(data_token_t token, size_t system_size,
+	size_t num_lines, const real_t * a, const real_t * b, const real_t * c,
+	const real_t * s, const real_t * n, const real_t * f, real_t * u,
+	real_t omega, size_t sweeps) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(system_size == 0 || num_lines == 0 || a == nullptr ||
+		b == nullptr || c == nullptr || s == nullptr || n == nullptr ||
+		f == nullptr || u == nullptr) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	if(sweeps == 0) {
+		return TRICYCL_SUCCESS;
+	} // if
+
+	// lines are padded to a power of two, so any line that fits in one
+	// work group is smoothed on the device, longer lines on the host
+	const size_t items = padded_size(system_size);
+	const tuning_t tuning = plan(token, items, num_lines, false);
+
+	if(tuning.sub_size == items && items <= local_sub_size(token)) {
+		const int32_t ierr = smooth_device(token, system_size, num_lines,
+			a, b, c, s, n, f, u, omega, sweeps);
+
+		if(ierr == CL_SUCCESS) {
+			return TRICYCL_SUCCESS;
+		} // if
+
+		Stats::instance().device_failure();
+
+		if(!data(token).host_fallback) {
+			return ierr;
+		} // if
+
+		warning("Device smoothing failed with %s(%d), smoothing on the "
+			"host\n", error_to_string(ierr), ierr);
+	} // if
+
+	return smooth_host(system_size, num_lines, a, b, c, s, n, f, u, omega,
+		sweeps);
+} // TriCyCL<>::smooth
+
+/*----------------------------------------------------------------------------*
+ * Device line smoothing.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::smooth_device(data_token_t token, size_t system_size,
+	size_t num_lines, const real_t * a, const real_t * b, const real_t * c,
+	const real_t * s, const real_t * n, const real_t * f, real_t * u,
+	real_t omega, size_t sweeps) {
+	CALLER_SELF
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	cl_context context = data(token).context;
+	cl_command_queue queue = local->queue;
+	cl_kernel kernel = local->smooth_kernel;
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	const size_t bytes(system_size*num_lines*sizeof(real_t));
+	int32_t ierr = 0;
+	solve_resources_t r;
+
+	/*-------------------------------------------------------------------------*
+	 * Upload the operator, the right-hand side and u.
+	 *-------------------------------------------------------------------------*/
+	const real_t * arrays[6] = { a, b, c, s, n, f };
+
+	for(size_t i(0); i<6; ++i) {
+		ierr |= create_buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			bytes, r.mem[i], const_cast<real_t *>(arrays[i]));
+	} // for
+
+	ierr |= create_buffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+		bytes, r.mem[6], u);
+	ierr |= create_buffer(context, CL_MEM_READ_WRITE, bytes, r.mem[7], NULL);
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	stats.phase(TRICYCL_PHASE_UPLOAD, solve_start, Stats::now());
+
+	/*-------------------------------------------------------------------------*
+	 * Sweeps, each waiting for the previous one.
+	 *-------------------------------------------------------------------------*/
+	const size_t items(padded_size(system_size));
+	int32_t line_iterations(iterations(items));
+
+	ierr = 0;
+
+	for(size_t i(0); i<6; ++i) {
+		ierr |= clSetKernelArg(kernel, i, sizeof(cl_mem), &r.mem[i]);
+	} // for
+
+	ierr |= clSetKernelArg(kernel, 8, pcr_local_memory(items), NULL);
+	ierr |= clSetKernelArg(kernel, 9, sizeof(int32_t), &system_size);
+	ierr |= clSetKernelArg(kernel, 10, sizeof(int32_t), &num_lines);
+	ierr |= clSetKernelArg(kernel, 11, sizeof(int32_t), &line_iterations);
+	ierr |= clSetKernelArg(kernel, 12, sizeof(real_t), &omega);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	const Stats::time_point_t phase_start = Stats::now();
+
+	for(size_t k(0); k<sweeps; ++k) {
+		ierr = 0;
+		ierr |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &r.mem[6 + k%2]);
+		ierr |= clSetKernelArg(kernel, 7, sizeof(cl_mem),
+			&r.mem[6 + (k+1)%2]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		size_t offset(0);
+		size_t global_size(items*num_lines);
+		size_t local_size(items);
+		cl_event event;
+
+		ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+			&local_size, k > 0 ? 1 : 0, k > 0 ? &r.level_events.back() : NULL,
+			&event);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "smooth", ierr);
+		} // if
+
+		// released with the other resources
+		r.level_events.push_back(event);
+	} // for
+
+	/*-------------------------------------------------------------------------*
+	 * Read back after the last sweep and wait once.
+	 *-------------------------------------------------------------------------*/
+	ierr = clEnqueueReadBuffer(queue, r.mem[6 + sweeps%2], 0, 0, bytes, u, 1,
+		&r.level_events.back(), &r.events[0]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+	} // if
+
+	ierr = clWaitForEvents(1, &r.events[0]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	const Stats::time_point_t end = Stats::now();
+
+	stats.phase(TRICYCL_PHASE_PCR, phase_start, end, r.level_events.size(),
+		&r.level_events[0]);
+	stats.phase(TRICYCL_PHASE_READBACK, end, end, 1, &r.events[0]);
+	stats.bytes(7*bytes, bytes);
+	stats.solve(solve_start, end, system_size, num_lines, items,
+		line_iterations, 0, 0);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::smooth_device
+
+/*----------------------------------------------------------------------------*
+ * Host line smoothing.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::smooth_host(size_t system_size, size_t num_lines,
+	const real_t * a, const real_t * b, const real_t * c, const real_t * s,
+	const real_t * n, const real_t * f, real_t * u, real_t omega,
+	size_t sweeps) {
+	const Stats::time_point_t start = Stats::now();
+	const size_t full_size(system_size*num_lines);
+	std::vector<real_t> w, x, previous;
+
+	try {
+		w.resize(system_size);
+		x.resize(system_size);
+		previous.resize(full_size);
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	for(size_t k(0); k<sweeps; ++k) {
+		// every line sees the neighbouring lines before this sweep
+		std::copy(u, u + full_size, previous.begin());
+
+		for(size_t l(0); l<num_lines; ++l) {
+			const size_t o(l*system_size);
+			const real_t * v = &previous[o];
+
+			for(size_t i(0); i<system_size; ++i) {
+				const size_t j(o + i);
+				real_t r = f[j] - b[j]*v[i];
+
+				if(i > 0) {
+					r -= a[j]*v[i-1];
+				} // if
+
+				if(i < system_size-1) {
+					r -= c[j]*v[i+1];
+				} // if
+
+				if(l > 0) {
+					r -= s[j]*previous[j - system_size];
+				} // if
+
+				if(l < num_lines-1) {
+					r -= n[j]*previous[j + system_size];
+				} // if
+
+				x[i] = r;
+			} // for
+
+			thomas_host(system_size, 1, a + o, b + o, c + o, &x[0], &x[0],
+				&w[0]);
+
+			for(size_t i(0); i<system_size; ++i) {
+				u[o + i] = v[i] + omega*x[i];
+			} // for
+		} // for
+	} // for
+
+	const Stats::time_point_t end = Stats::now();
+	Stats & stats = Stats::instance();
+
+	stats.phase(TRICYCL_PHASE_HOST, start, end);
+	stats.solve(start, end, system_size, num_lines, 0, 0, 0, 0);
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::smooth_host
+
+/*----------------------------------------------------------------------------*
+ * Symmetric solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_symmetric(data_token_t token, size_t system_size,
+	size_t num_systems, real_t * b, real_t * e, real_t * d, real_t * x) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(system_size == 0 || num_systems == 0 || b == nullptr ||
+		e == nullptr || d == nullptr || x == nullptr) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	solver_data_t & solver_data = data(token);
+	const cost_model_t & model = solver_data.cost_model;
+	const size_t sub_size(symmetric_sub_size(token, system_size,
+		num_systems));
+	const double rows(system_size*num_systems);
+	bool host(false);
+
+	// the planner weighs the device solve against the host
+	if(sub_size > 0 && (!solver_data.planner ||
+		model.device_latency + model.device_row*rows < model.host_row*rows)) {
+		const int32_t ierr = solve_symmetric_device(token, sub_size,
+			system_size, num_systems, b, e, d, x);
+
+		if(ierr == CL_SUCCESS) {
+			return TRICYCL_SUCCESS;
+		} // if
+
+		Stats::instance().device_failure();
+
+		if(!solver_data.host_fallback) {
+			return ierr;
+		} // if
+
+		warning("Device symmetric solve failed with %s(%d), solving on the "
+			"host\n", error_to_string(ierr), ierr);
+
+		host = true;
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Other shapes are expanded to the general solve.
+	 *-------------------------------------------------------------------------*/
+	const size_t full_size(system_size*num_systems);
+	std::vector<real_t> a, c;
+
+	try {
+		a.resize(full_size);
+		c.resize(full_size);
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	for(size_t s(0); s<num_systems; ++s) {
+		const size_t o(s*system_size);
+
+		a[o] = 0.0;
+
+		for(size_t i(1); i<system_size; ++i) {
+			a[o + i] = e[o + i-1];
+			c[o + i-1] = e[o + i-1];
+		} // for
+
+		c[o + system_size-1] = 0.0;
+	} // for
+
+	if(host || (sub_size > 0 && solver_data.planner)) {
+		return solve_host(system_size, num_systems, &a[0], b, &c[0], d, x);
+	} // if
+
+	return solve(token, system_size, num_systems, &a[0], b, &c[0], d, x);
+} // TriCyCL<>::solve_symmetric
+
+/*----------------------------------------------------------------------------*
+ * Sub-system size for the symmetric kernels.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+size_t
+TriCyCL<real_t>::symmetric_sub_size(data_token_t token, size_t system_size,
+	size_t num_systems) {
+	const size_t work_group_size = data(token).kernel_info.work_group_size;
+	const cl_ulong local_mem_size = data(token).device_info.local_mem_size;
+
+	for(size_t sub_size(max_sub_size(token, system_size)); sub_size > 1;
+		sub_size /= 2) {
+		if(system_size%sub_size != 0 ||
+			pcr_symmetric_local_memory(sub_size) > local_mem_size) {
+			continue;
+		} // if
+
+		if(sub_size == system_size) {
+			return sub_size;
+		} // if
+
+		const size_t interface_size(2*(system_size/sub_size)*num_systems);
+
+		if(sub_size >= 4 && (interface_size & (interface_size-1)) == 0 &&
+			interface_size <= work_group_size &&
+			pcr_symmetric_local_memory(interface_size) <= local_mem_size) {
+			return sub_size;
+		} // if
+	} // for
+
+	return 0;
+} // TriCyCL<>::symmetric_sub_size
+
+/*----------------------------------------------------------------------------*
+ * Device symmetric solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_symmetric_device(data_token_t token, size_t sub_size,
+	size_t system_size, size_t num_systems, real_t * b, real_t * e,
+	real_t * d, real_t * x) {
+	CALLER_SELF
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	cl_context context = data(token).context;
+	cl_command_queue queue = local->queue;
+	cl_kernel kernel = local->symmetric_kernel;
+	cl_kernel copy_kernel = local->symmetric_copy_kernel;
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	const size_t sub_systems(system_size/sub_size);
+	const size_t full_size(system_size*num_systems);
+	const size_t bytes(full_size*sizeof(real_t));
+	const bool partitioned(sub_systems > 1);
+	size_t interface_size(partitioned ? 2*sub_systems*num_systems : 0);
+	size_t interface_iterations(iterations(interface_size));
+	size_t sub_iterations(iterations(sub_size));
+	int32_t ierr = 0;
+	solve_resources_t r;
+
+	cl_mem & d_ib = r.mem[1];
+	cl_mem & d_ic = r.mem[2];
+	cl_mem & d_id = r.mem[3];
+	cl_mem & d_ix = r.mem[4];
+	cl_mem & d_b = r.mem[6];
+	cl_mem & d_e = r.mem[7];
+	cl_mem & d_d = r.mem[8];
+	cl_mem & d_x = r.mem[9];
+
+	/*-------------------------------------------------------------------------*
+	 * Setup interface system.
+	 *-------------------------------------------------------------------------*/
+	if(partitioned) {
+		const Stats::time_point_t phase_start = Stats::now();
+
+		try {
+			r.interface = create_symmetric_interface_system(system_size,
+				num_systems, sub_size, sub_systems, b, e, d);
+		}
+		catch(std::bad_alloc &) {
+			return CL_OUT_OF_HOST_MEMORY;
+		} // try
+
+		stats.phase(TRICYCL_PHASE_INTERFACE, phase_start, Stats::now());
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Upload three arrays per system and interface.
+	 *-------------------------------------------------------------------------*/
+	const Stats::time_point_t upload_start = Stats::now();
+	cl_mem_flags flags = CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR;
+
+	if(partitioned) {
+		const size_t ibytes(interface_size*sizeof(real_t));
+
+		ierr |= create_buffer(context, flags, ibytes, d_ib, r.interface->b);
+		ierr |= create_buffer(context, flags, ibytes, d_ic, r.interface->c);
+		ierr |= create_buffer(context, flags, ibytes, d_id, r.interface->d);
+		ierr |= create_buffer(context, CL_MEM_READ_WRITE, ibytes, d_ix, NULL);
+	} // if
+
+	ierr |= create_buffer(context, flags, bytes, d_b, b);
+	ierr |= create_buffer(context, flags, bytes, d_e, e);
+	ierr |= create_buffer(context, flags, bytes, d_d, d);
+	ierr |= create_buffer(context, CL_MEM_WRITE_ONLY, bytes, d_x, NULL);
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	stats.phase(TRICYCL_PHASE_UPLOAD, upload_start, Stats::now());
+
+	size_t offset(0);
+	size_t global_size(0);
+	size_t local_size(0);
+	cl_event * events = r.events;
+	const Stats::time_point_t phase_start = Stats::now();
+
+	if(partitioned) {
+		/*----------------------------------------------------------------------*
+		 * Solve interface system.
+		 *----------------------------------------------------------------------*/
+		ierr = 0;
+		ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_ib);
+		ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_ic);
+		ierr |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_id);
+		ierr |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_ix);
+		ierr |= clSetKernelArg(kernel, 4,
+			pcr_symmetric_local_memory(interface_size), NULL);
+		ierr |= clSetKernelArg(kernel, 5, sizeof(int32_t), &interface_size);
+		ierr |= clSetKernelArg(kernel, 6, sizeof(int32_t),
+			&interface_iterations);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		global_size = interface_size;
+		local_size = interface_size;
+
+		ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset,
+			&global_size, &local_size, 0, NULL, &events[4]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve_symmetric",
+				ierr);
+		} // if
+
+		/*----------------------------------------------------------------------*
+		 * Copy interface results into full system.
+		 *----------------------------------------------------------------------*/
+		ierr = 0;
+		ierr |= clSetKernelArg(copy_kernel, 0, sizeof(cl_mem), &d_b);
+		ierr |= clSetKernelArg(copy_kernel, 1, sizeof(cl_mem), &d_e);
+		ierr |= clSetKernelArg(copy_kernel, 2, sizeof(cl_mem), &d_d);
+		ierr |= clSetKernelArg(copy_kernel, 3, sizeof(cl_mem), &d_ix);
+		ierr |= clSetKernelArg(copy_kernel, 4, sizeof(int32_t), &system_size);
+		ierr |= clSetKernelArg(copy_kernel, 5, sizeof(int32_t), &sub_size);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		local_size = interface_size/num_systems;
+
+		ierr = clEnqueueNDRangeKernel(queue, copy_kernel, 1, &offset,
+			&global_size, &local_size, 1, &events[4], &events[5]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve_symmetric",
+				ierr);
+		} // if
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Solve full system.
+	 *-------------------------------------------------------------------------*/
+	ierr = 0;
+	ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_b);
+	ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_e);
+	ierr |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_d);
+	ierr |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_x);
+	ierr |= clSetKernelArg(kernel, 4, pcr_symmetric_local_memory(sub_size),
+		NULL);
+	ierr |= clSetKernelArg(kernel, 5, sizeof(int32_t), &sub_size);
+	ierr |= clSetKernelArg(kernel, 6, sizeof(int32_t), &sub_iterations);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	global_size = full_size;
+	local_size = sub_size;
+
+	ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+		&local_size, partitioned ? 1 : 0, partitioned ? &events[5] : NULL,
+		&events[6]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve_symmetric", ierr);
+	} // if
+
+	/*-------------------------------------------------------------------------*
+	 * Read back and wait once.
+	 *-------------------------------------------------------------------------*/
+	ierr = clEnqueueReadBuffer(queue, d_x, 0, offset, bytes, x, 1,
+		&events[6], &events[7]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+	} // if
+
+	ierr = clWaitForEvents(1, &events[7]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	const Stats::time_point_t end = Stats::now();
+
+	if(partitioned) {
+		stats.phase(TRICYCL_PHASE_INTERFACE_PCR, end, end, 1, &events[4]);
+		stats.phase(TRICYCL_PHASE_UNCOUPLE, end, end, 1, &events[5]);
+	} // if
+
+	stats.phase(TRICYCL_PHASE_PCR, phase_start, end, 1, &events[6]);
+	stats.phase(TRICYCL_PHASE_READBACK, end, end, 1, &events[7]);
+	stats.bytes((3*full_size + 3*interface_size)*sizeof(real_t), bytes);
+	stats.solve(solve_start, end, system_size, num_systems, sub_size,
+		sub_iterations, interface_size, interface_iterations);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::solve_symmetric_device
+
+/*----------------------------------------------------------------------------*
+ * Packed solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_packed(data_token_t token, size_t system_size,
+	size_t num_systems, const real_t * rows, real_t * x) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(system_size == 0 || num_systems == 0 || rows == nullptr ||
+		x == nullptr) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	// systems that need an interface or several rows per work-item are
+	// unpacked for the general solve
+	const tuning_t tuning = plan(token, system_size, num_systems, false);
+	bool host(false);
+
+	if(tuning.sub_size == system_size && tuning.rows == 1 &&
+		global_levels(token, tuning.sub_size) == 0) {
+		const int32_t ierr = solve_packed_device(token, system_size,
+			num_systems, rows, x);
+
+		if(ierr == CL_SUCCESS) {
+			return TRICYCL_SUCCESS;
+		} // if
+
+		Stats::instance().device_failure();
+
+		if(!data(token).host_fallback) {
+			return ierr;
+		} // if
+
+		warning("Device packed solve failed with %s(%d), solving on the "
+			"host\n", error_to_string(ierr), ierr);
+
+		host = true;
+	} // if
+
+	const size_t full_size(system_size*num_systems);
+	std::vector<real_t> a, b, c, d;
+
+	try {
+		a.resize(full_size);
+		b.resize(full_size);
+		c.resize(full_size);
+		d.resize(full_size);
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	for(size_t i(0); i<full_size; ++i) {
+		a[i] = rows[4*i];
+		b[i] = rows[4*i+1];
+		c[i] = rows[4*i+2];
+		d[i] = rows[4*i+3];
+	} // for
+
+	if(host) {
+		return solve_host(system_size, num_systems, &a[0], &b[0], &c[0],
+			&d[0], x);
+	} // if
+
+	return solve(token, system_size, num_systems, &a[0], &b[0], &c[0],
+		&d[0], x);
+} // TriCyCL<>::solve_packed
+
+/*----------------------------------------------------------------------------*
+ * Device packed solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::solve_packed_device(data_token_t token, size_t system_size,
+	size_t num_systems, const real_t * rows, real_t * x) {
+	CALLER_SELF
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	cl_context context = data(token).context;
+	cl_command_queue queue = local->queue;
+	cl_kernel kernel = local->packed_kernel;
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	const size_t bytes(system_size*num_systems*sizeof(real_t));
+	int32_t ierr = 0;
+	solve_resources_t r;
+
+	/*-------------------------------------------------------------------------*
+	 * One buffer for all coefficients.
+	 *-------------------------------------------------------------------------*/
+	ierr |= create_buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		4*bytes, r.mem[0], const_cast<real_t *>(rows));
+	ierr |= create_buffer(context, CL_MEM_WRITE_ONLY, bytes, r.mem[1], NULL);
+
+	if(ierr != CL_SUCCESS) {
+		return ierr;
+	} // if
+
+	stats.phase(TRICYCL_PHASE_UPLOAD, solve_start, Stats::now());
+
+	/*-------------------------------------------------------------------------*
+	 * Solve and read back, waiting once.
+	 *-------------------------------------------------------------------------*/
+	int32_t sub_iterations(iterations(system_size));
+
+	ierr = 0;
+	ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &r.mem[0]);
+	ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &r.mem[1]);
+	ierr |= clSetKernelArg(kernel, 2, pcr_local_memory(system_size), NULL);
+	ierr |= clSetKernelArg(kernel, 3, sizeof(int32_t), &system_size);
+	ierr |= clSetKernelArg(kernel, 4, sizeof(int32_t), &sub_iterations);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	const Stats::time_point_t phase_start = Stats::now();
+	size_t offset(0);
+	size_t global_size(system_size*num_systems);
+	size_t local_size(system_size);
+
+	ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+		&local_size, 0, NULL, &r.events[0]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "solve_packed", ierr);
+	} // if
+
+	ierr = clEnqueueReadBuffer(queue, r.mem[1], 0, 0, bytes, x, 1,
+		&r.events[0], &r.events[1]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+	} // if
+
+	ierr = clWaitForEvents(1, &r.events[1]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
+	} // if
+
+	const Stats::time_point_t end = Stats::now();
+
+	stats.phase(TRICYCL_PHASE_PCR, phase_start, end, 1, &r.events[0]);
+	stats.phase(TRICYCL_PHASE_READBACK, end, end, 1, &r.events[1]);
+	stats.bytes(4*bytes, bytes);
+	stats.solve(solve_start, end, system_size, num_systems, system_size,
+		sub_iterations, 0, 0);
+
+	return CL_SUCCESS;
+} // TriCyCL<>::solve_packed_device
+
+/*----------------------------------------------------------------------------*
+ * Create a device-resident batch.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::batch_create(data_token_t token, size_t system_size,
+	size_t num_systems, const real_t * a, const real_t * b, const real_t * c,
+	const real_t * d, batch_token_t & batch) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(system_size == 0 || num_systems == 0 || a == nullptr ||
+		b == nullptr || c == nullptr || d == nullptr ||
+		num_systems > std::numeric_limits<uint32_t>::max()) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	batch_t * resident = new (std::nothrow) batch_t(token,
+		data(token).context, system_size, num_systems);
+
+	if(resident == nullptr) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // if
+
+	const real_t * coefficients[4] = { a, b, c, d };
+	const size_t bytes(system_size*num_systems*sizeof(real_t));
+	int32_t ierr = 0;
+
+	// the host arrays are only read (copied at creation)
+	for(size_t i(0); i<4; ++i) {
+		ierr |= create_buffer(resident->context, CL_MEM_READ_WRITE |
+			CL_MEM_COPY_HOST_PTR, bytes, resident->mem[i],
+			const_cast<real_t *>(coefficients[i]));
+	} // for
 
 	if(ierr != CL_SUCCESS) {
-		CL_ABORTkernel(clEnqueueNDRangeKernel, ierr, "solve");
+		delete resident;
+		return ierr;
+	} // if
+
+	Stats::instance().bytes(4*bytes, 0);
+
+	std::lock_guard<std::mutex> lock(batch_mutex_);
+	batch = next_batch_++;
+	batches_[batch] = resident;
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::batch_create
+
+/*----------------------------------------------------------------------------*
+ * Replace the active systems of a batch.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::batch_update(data_token_t token, batch_token_t batch,
+	size_t num_active, const uint32_t * active, const real_t * a,
+	const real_t * b, const real_t * c, const real_t * d) {
+	CALLER_SELF
+	std::unique_lock<std::mutex> lock;
+	batch_t * resident = find_batch(token, batch, lock);
+
+	if(resident == nullptr) {
+		return token >= num_tokens_ ? TRICYCL_INVALID_TOKEN :
+			TRICYCL_INVALID_VALUE;
+	} // if
+
+	solve_resources_t r;
+	int32_t ierr = check_active(*resident, num_active, active, r.mem[0]);
+
+	if(ierr != TRICYCL_SUCCESS || num_active == 0) {
+		return ierr;
+	} // if
+
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	const Stats::time_point_t start = Stats::now();
+	const real_t * coefficients[4] = { a, b, c, d };
+	const size_t bytes(resident->system_size*num_active*sizeof(real_t));
+	size_t num_events(0);
+
+	// NULL arrays keep their resident values
+	for(size_t i(0); i<4; ++i) {
+		if(coefficients[i] == nullptr) {
+			continue;
+		} // if
+
+		ierr = create_buffer(resident->context, CL_MEM_READ_ONLY |
+			CL_MEM_COPY_HOST_PTR, bytes, r.mem[1+i],
+			const_cast<real_t *>(coefficients[i]));
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+
+		ierr = enqueue_batch_copy(local->scatter_kernel, local->queue,
+			r.mem[1+i], resident->mem[i], r.mem[0], resident->system_size,
+			num_active, &r.events[num_events]);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+
+		++num_events;
+	} // for
+
+	if(num_events > 0) {
+		ierr = clWaitForEvents(num_events, r.events);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clWaitForEvents, ierr, ierr);
+		} // if
+	} // if
+
+	Stats & stats = Stats::instance();
+	stats.phase(TRICYCL_PHASE_UPLOAD, start, Stats::now(), num_events,
+		r.events);
+	stats.bytes(num_events*bytes + num_active*sizeof(uint32_t), 0);
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::batch_update
+
+/*----------------------------------------------------------------------------*
+ * Solve the active systems of a batch.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::batch_solve(data_token_t token, batch_token_t batch,
+	size_t num_active, const uint32_t * active, real_t * x) {
+	CALLER_SELF
+	std::unique_lock<std::mutex> lock;
+	batch_t * resident = find_batch(token, batch, lock);
+
+	if(resident == nullptr) {
+		return token >= num_tokens_ ? TRICYCL_INVALID_TOKEN :
+			TRICYCL_INVALID_VALUE;
+	} // if
+
+	if(x == nullptr) {
+		return TRICYCL_INVALID_VALUE;
 	} // if
 
+	solve_resources_t r;
+	int32_t ierr = check_active(*resident, num_active, active, r.mem[0]);
+
+	if(ierr != TRICYCL_SUCCESS || num_active == 0) {
+		return ierr;
+	} // if
+
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	cl_command_queue queue = local->queue;
+	Stats & stats = Stats::instance();
+	const Stats::time_point_t solve_start = Stats::now();
+	Stats::time_point_t phase_start = solve_start;
+
+	const size_t system_size(resident->system_size);
+	const size_t full_size(system_size*num_active);
+	const size_t bytes(full_size*sizeof(real_t));
+
 	/*-------------------------------------------------------------------------*
-	 * Block for full system solve kernel.
+	 * Gather the active systems.
 	 *-------------------------------------------------------------------------*/
-	ierr = clWaitForEvents(1, &event);
+	for(size_t i(0); i<4; ++i) {
+		ierr = create_buffer(resident->context, CL_MEM_READ_WRITE, bytes,
+			r.mem[1+i], NULL);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+
+		ierr = enqueue_batch_copy(local->gather_kernel, queue, resident->mem[i],
+			r.mem[1+i], r.mem[0], system_size, num_active, &r.events[i]);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+	} // for
+
+	ierr = clWaitForEvents(4, r.events);
 
 	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clWaitForEvents, ierr);
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
 	} // if
 
+	stats.phase(TRICYCL_PHASE_UPLOAD, phase_start, Stats::now(), 4, r.events);
+	stats.bytes(num_active*sizeof(uint32_t), 0);
+
 	/*-------------------------------------------------------------------------*
-	 * Read full system solution.
+	 * Systems that fit in one work group are solved where they are,
+	 * others are read back and go through the regular solve.
 	 *-------------------------------------------------------------------------*/
-	ierr = clEnqueueReadBuffer(queue, d_x, 1, offset,
-		system_size*num_systems*sizeof(real_t), x, 0, NULL, NULL);
+	const tuning_t tuning = plan(token, system_size, num_active);
+
+	if(tuning.sub_size != system_size ||
+		(tuning.rows == 1 && global_levels(token, system_size) > 0)) {
+		std::vector<real_t> compact;
+
+		try {
+			compact.resize(4*full_size);
+		}
+		catch(std::bad_alloc &) {
+			return TRICYCL_OUT_OF_HOST_MEMORY;
+		} // try
+
+		for(size_t i(0); i<4; ++i) {
+			ierr = clEnqueueReadBuffer(queue, r.mem[1+i], 1, 0, bytes,
+				&compact[i*full_size], 0, NULL, NULL);
+
+			if(ierr != CL_SUCCESS) {
+				CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+			} // if
+		} // for
+
+		stats.bytes(0, 4*bytes);
+
+		return solve(token, system_size, num_active, &compact[0],
+			&compact[full_size], &compact[2*full_size], &compact[3*full_size],
+			x);
+	} // if
+
+	const size_t items(system_size/tuning.rows);
+	size_t sub_iterations(iterations(items));
+
+	// the gathered copies are scratch, so thomas_kernel solves in place in
+	// them and the solution is read back from the gathered d
+	const bool thomas(thomas_tuning(tuning, system_size));
+	cl_mem d_out = thomas ? r.mem[4] : r.mem[5];
+
+	if(thomas) {
+		phase_start = Stats::now();
+		ierr = enqueue_thomas(token, *local, queue, r.mem[1], r.mem[2],
+			r.mem[3], r.mem[4], r.mem[3], r.mem[4], system_size, num_active,
+			&r.events[4]);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+	}
+	else {
+		ierr = create_buffer(resident->context, CL_MEM_WRITE_ONLY, bytes,
+			r.mem[5], NULL);
+
+		if(ierr != CL_SUCCESS) {
+			return ierr;
+		} // if
+
+		local->trim();
+
+		const bool multi_row(tuning.rows > 1);
+		cl_kernel kernel = multi_row ? rows_kernel(*local, tuning.rows) :
+			select_pcr_kernel(token, system_size, tuning.native_divide,
+			tuning.variant);
+
+		if(kernel == NULL) {
+			return CL_INVALID_KERNEL;
+		} // if
+
+		ierr = 0;
+		ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &r.mem[1]);
+		ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &r.mem[2]);
+		ierr |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &r.mem[3]);
+		ierr |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &r.mem[4]);
+		ierr |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &r.mem[5]);
+		ierr |= clSetKernelArg(kernel, 5, multi_row ?
+			pcr_rows_local_memory(items) : pcr_local_memory(system_size), NULL);
+		ierr |= clSetKernelArg(kernel, 6, sizeof(int32_t), &system_size);
+		ierr |= clSetKernelArg(kernel, 7, sizeof(int32_t), multi_row ?
+			&tuning.rows : &num_active);
+		ierr |= clSetKernelArg(kernel, 8, sizeof(int32_t), &sub_iterations);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNerr(clSetKernelArg, ierr, ierr);
+		} // if
+
+		size_t offset(0);
+		size_t global_size(full_size/tuning.rows);
+		size_t local_size(items);
+
+		phase_start = Stats::now();
+		ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+			&local_size, 0, NULL, &r.events[4]);
+
+		if(ierr != CL_SUCCESS) {
+			CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "batch_solve", ierr);
+		} // if
+	} // if
+
+	ierr = clWaitForEvents(1, &r.events[4]);
 
 	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clEnqueueReadBuffer, ierr);
+		CL_RETURNerr(clWaitForEvents, ierr, ierr);
 	} // if
 
-	delete interface;
+	stats.phase(TRICYCL_PHASE_PCR, phase_start, Stats::now(), 1,
+		&r.events[4]);
 
-	return ierr;
-} // TriCyCL<>::solve
+	phase_start = Stats::now();
+	ierr = clEnqueueReadBuffer(queue, d_out, 1, 0, bytes, x, 0, NULL,
+		&r.events[5]);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clEnqueueReadBuffer, ierr, ierr);
+	} // if
+
+	stats.phase(TRICYCL_PHASE_READBACK, phase_start, Stats::now(), 1,
+		&r.events[5]);
+
+	stats.bytes(0, bytes);
+	stats.solve(solve_start, Stats::now(), system_size, num_active,
+		system_size, sub_iterations, 0, 0);
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::batch_solve
+
+/*----------------------------------------------------------------------------*
+ * Destroy a batch.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::batch_destroy(data_token_t token, batch_token_t batch) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	batch_t * resident(nullptr);
+
+	{
+		// operations hold the batch mutex from lookup to return, so once
+		// it is taken here no other thread can reach the batch
+		std::lock_guard<std::mutex> lock(batch_mutex_);
+		typename std::map<batch_token_t, batch_t *>::iterator ita =
+			batches_.find(batch);
+
+		if(ita == batches_.end() || ita->second->token != token) {
+			return TRICYCL_INVALID_VALUE;
+		} // if
+
+		resident = ita->second;
+		resident->mutex.lock();
+		batches_.erase(ita);
+	}
+
+	resident->mutex.unlock();
+	delete resident;
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::batch_destroy
+
+/*----------------------------------------------------------------------------*
+ * Begin deferring solves.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::batch_begin(data_token_t token) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	// solves recorded before an earlier begin without flush are dropped
+	local->deferring = true;
+	local->deferred.clear();
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::batch_begin
+
+/*----------------------------------------------------------------------------*
+ * Record a deferred solve.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::batch_add(data_token_t token, size_t system_size,
+	size_t num_systems, const real_t * a, const real_t * b,
+	const real_t * c, const real_t * d, real_t * x) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	if(system_size == 0 || num_systems == 0 || a == nullptr ||
+		b == nullptr || c == nullptr || d == nullptr || x == nullptr) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	if(!local->deferring) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	const deferred_t solve = { system_size, num_systems, a, b, c, d, x };
+
+	try {
+		local->deferred.push_back(solve);
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	return TRICYCL_SUCCESS;
+} // TriCyCL<>::batch_add
+
+/*----------------------------------------------------------------------------*
+ * Solve the deferred solves.
+ *
+ * Solves of one system size are concatenated in the order they were
+ * added.  A group that fails does not stop the others; the first error is
+ * returned.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::batch_flush(data_token_t token) {
+	if(token >= num_tokens_) {
+		return TRICYCL_INVALID_TOKEN;
+	} // if
+
+	thread_data_t * local = thread_data(token);
+
+	if(local == NULL) {
+		return CL_INVALID_COMMAND_QUEUE;
+	} // if
+
+	if(!local->deferring) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	std::vector<deferred_t> deferred;
+	deferred.swap(local->deferred);
+	local->deferring = false;
+
+	// group by system size, keeping the order of batch_add
+	std::map<size_t, std::vector<size_t> > groups;
+
+	try {
+		for(size_t i(0); i<deferred.size(); ++i) {
+			groups[deferred[i].system_size].push_back(i);
+		} // for
+	}
+	catch(std::bad_alloc &) {
+		return TRICYCL_OUT_OF_HOST_MEMORY;
+	} // try
+
+	int32_t result = TRICYCL_SUCCESS;
+
+	for(typename std::map<size_t, std::vector<size_t> >::iterator
+		ita = groups.begin(); ita != groups.end(); ++ita) {
+		const size_t system_size(ita->first);
+		const std::vector<size_t> & members = ita->second;
+		int32_t ierr;
+
+		if(members.size() == 1) {
+			const deferred_t & s = deferred[members[0]];
+
+			ierr = solve(token, system_size, s.num_systems,
+				const_cast<real_t *>(s.a), const_cast<real_t *>(s.b),
+				const_cast<real_t *>(s.c), const_cast<real_t *>(s.d), s.x);
+		}
+		else {
+			size_t num_systems(0);
+
+			for(size_t i(0); i<members.size(); ++i) {
+				num_systems += deferred[members[i]].num_systems;
+			} // for
+
+			const size_t full_size(system_size*num_systems);
+			std::vector<real_t> a, b, c, d, x;
+
+			try {
+				a.resize(full_size);
+				b.resize(full_size);
+				c.resize(full_size);
+				d.resize(full_size);
+				x.resize(full_size);
+			}
+			catch(std::bad_alloc &) {
+				if(result == TRICYCL_SUCCESS) {
+					result = TRICYCL_OUT_OF_HOST_MEMORY;
+				} // if
+
+				continue;
+			} // try
+
+			size_t offset(0);
+
+			for(size_t i(0); i<members.size(); ++i) {
+				const deferred_t & s = deferred[members[i]];
+				const size_t size(system_size*s.num_systems);
+
+				std::copy(s.a, s.a + size, a.begin() + offset);
+				std::copy(s.b, s.b + size, b.begin() + offset);
+				std::copy(s.c, s.c + size, c.begin() + offset);
+				std::copy(s.d, s.d + size, d.begin() + offset);
+				offset += size;
+			} // for
+
+			ierr = solve(token, system_size, num_systems, &a[0], &b[0],
+				&c[0], &d[0], &x[0]);
+
+			offset = 0;
+
+			for(size_t i(0); i<members.size() && ierr == TRICYCL_SUCCESS;
+				++i) {
+				const deferred_t & s = deferred[members[i]];
+				const size_t size(system_size*s.num_systems);
+
+				std::copy(x.begin() + offset, x.begin() + offset + size, s.x);
+				offset += size;
+			} // for
+		} // if
+
+		if(ierr != TRICYCL_SUCCESS && result == TRICYCL_SUCCESS) {
+			result = ierr;
+		} // if
+	} // for
+
+	return result;
+} // TriCyCL<>::batch_flush
+
+/*----------------------------------------------------------------------------*
+ * Batch lookup.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+typename TriCyCL<real_t>::batch_t *
+TriCyCL<real_t>::find_batch(data_token_t token, batch_token_t batch,
+	std::unique_lock<std::mutex> & lock) {
+	if(token >= num_tokens_) {
+		return nullptr;
+	} // if
+
+	std::lock_guard<std::mutex> batches_lock(batch_mutex_);
+	typename std::map<batch_token_t, batch_t *>::iterator ita =
+		batches_.find(batch);
+
+	if(ita == batches_.end() || ita->second->token != token) {
+		return nullptr;
+	} // if
+
+	lock = std::unique_lock<std::mutex>(ita->second->mutex);
+
+	return ita->second;
+} // TriCyCL<>::find_batch
+
+/*----------------------------------------------------------------------------*
+ * Check and upload an active list.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::check_active(batch_t & batch, size_t num_active,
+	const uint32_t * active, cl_mem & d_active) {
+	if(num_active == 0) {
+		return TRICYCL_SUCCESS;
+	} // if
+
+	if(active == nullptr || num_active > batch.num_systems) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	for(size_t i(0); i<num_active; ++i) {
+		if(active[i] >= batch.num_systems) {
+			return TRICYCL_INVALID_VALUE;
+		} // if
+	} // for
+
+	return create_buffer(batch.context, CL_MEM_READ_ONLY |
+		CL_MEM_COPY_HOST_PTR, num_active*sizeof(uint32_t), d_active,
+		const_cast<uint32_t *>(active));
+} // TriCyCL<>::check_active
+
+/*----------------------------------------------------------------------------*
+ * Enqueue a gather or scatter of the active systems.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+int32_t
+TriCyCL<real_t>::enqueue_batch_copy(cl_kernel kernel,
+	cl_command_queue queue, cl_mem from, cl_mem to, cl_mem d_active,
+	size_t system_size, size_t num_active, cl_event * event) {
+	CALLER_SELF
+	int32_t ierr = 0;
+
+	ierr |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &from);
+	ierr |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &to);
+	ierr |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_active);
+	ierr |= clSetKernelArg(kernel, 3, sizeof(int32_t), &system_size);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNerr(clSetKernelArg, ierr, ierr);
+	} // if
+
+	size_t offset(0);
+	size_t global_size(system_size*num_active);
+
+	ierr = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size,
+		NULL, 0, NULL, event);
+
+	if(ierr != CL_SUCCESS) {
+		CL_RETURNkernel(clEnqueueNDRangeKernel, ierr, "batch_copy", ierr);
+	} // if
+
+	return CL_SUCCESS;
+} // TriCyCL<>::enqueue_batch_copy
+
+/*----------------------------------------------------------------------------*
+ * Truncated SPIKE interface.
+ *
+ * The interface rows are ordered first, last for each partition.  The
+ * approximation keeps the 2x2 blocks coupling the last row of one
+ * partition with the first row of the next and drops the couplings to
+ * the far end of each partition (E).  For a row diagonally dominant
+ * block matrix M', |M'^-1 E y| <= rho |y| row by row, with
+ * rho = max |E_i|/(|m_ii| - |m_ij|), and the sub-system solves do not
+ * amplify errors in their boundary values, so the relative error of the
+ * solution is at most rho.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+double
+TriCyCL<real_t>::truncate_interface(interface_t & interface,
+	size_t full_size, const real_t * a, const real_t * b, const real_t * c) {
+	const double infinity = std::numeric_limits<double>::infinity();
+	const size_t n = interface.elements;
+	const real_t * ia = interface.a;
+	const real_t * ib = interface.b;
+	const real_t * ic = interface.c;
+	const real_t * id = interface.d;
+	real_t * ix = interface.x;
+
+	// the bound needs a row diagonally dominant system
+	for(size_t i(0); i<full_size; ++i) {
+		if(std::abs(b[i]) < std::abs(a[i]) + std::abs(c[i])) {
+			return infinity;
+		} // if
+	} // for
+
+	// first row of the first partition and last row of the last
+	ix[0] = id[0]/ib[0];
+	ix[n-1] = id[n-1]/ib[n-1];
+
+	double rho = std::max(std::abs(ic[0]/ib[0]),
+		std::abs(ia[n-1]/ib[n-1]));
+
+	for(size_t i(1); i+1<n; i+=2) {
+		const size_t j(i+1);
+		const double margin_i = std::abs(ib[i]) - std::abs(ic[i]);
+		const double margin_j = std::abs(ib[j]) - std::abs(ia[j]);
+
+		if(margin_i <= 0.0 || margin_j <= 0.0) {
+			return infinity;
+		} // if
+
+		rho = std::max(rho, std::abs(ia[i])/margin_i);
+		rho = std::max(rho, std::abs(ic[j])/margin_j);
+
+		const real_t det = ib[i]*ib[j] - ic[i]*ia[j];
+		ix[i] = (id[i]*ib[j] - ic[i]*id[j])/det;
+		ix[j] = (ib[i]*id[j] - ia[j]*id[i])/det;
+	} // for
+
+	return rho;
+} // TriCyCL<>::truncate_interface
 
 /*----------------------------------------------------------------------------*
  * Create the interface system.
@@ -625,12 +5241,13 @@ TriCyCL<real_t>::create_interface_system(size_t system_size,
 			ic[lroff] = c[roff+sub_size-2];
 			id[lroff] = d[roff+sub_size-2];
 
-			// eliminate interface super-diagonal
-			for(size_t i=sub_size-3; i != 0; --i) {
-				const real_t ratio = -1.0*c[roff+i]/ib[lroff];
+			// eliminate interface super-diagonal (down to and including
+			// the first row of the sub-system)
+			for(size_t i=sub_size-2; i != 0; --i) {
+				const real_t ratio = -1.0*c[roff+i-1]/ib[lroff];
 
 				// ia is static
-				ib[lroff] = ratio*a[roff+i+1] + b[roff+i];
+				ib[lroff] = ratio*a[roff+i] + b[roff+i-1];
 				ic[lroff] = ratio*ic[lroff];
 				id[lroff] = ratio*id[lroff] + d[roff+i-1];
 			} // for
@@ -640,12 +5257,71 @@ TriCyCL<real_t>::create_interface_system(size_t system_size,
 	return interface;
 } // create_interface_system
 
+/*----------------------------------------------------------------------------*
+ * Create symmetric interface systems.
+ *
+ * As create_interface_system with a[i] = e[i-1] and c[i] = e[i].  The
+ * interface rows are rows of the Schur complement, so the interface system
+ * is symmetric and its sub-diagonal is not needed.
+ *----------------------------------------------------------------------------*/
+
+template<typename real_t>
+typename TriCyCL<real_t>::interface_t *
+TriCyCL<real_t>::create_symmetric_interface_system(size_t system_size,
+	size_t num_systems, size_t sub_size, size_t sub_systems,
+	const real_t * b, const real_t * e, const real_t * d) {
+	interface_t * interface =
+		new interface_t(2*num_systems*sub_systems);
+
+	real_t * ib = interface->b;
+	real_t * ic = interface->c;
+	real_t * id = interface->d;
+
+	for(size_t s(0); s<num_systems; ++s) {
+		const size_t soff = s*system_size;
+		const size_t lsoff = s*2*sub_systems;
+
+		for(size_t r(0); r<sub_systems; ++r) {
+			const size_t roff = soff + r*sub_size;
+			const size_t lroff = lsoff + 2*r;
+
+			// e of the last row of a system is ignored
+			ib[lroff+1] = b[roff+1];
+			ic[lroff+1] = r < sub_systems-1 ? e[roff+sub_size-1] : 0.0;
+			id[lroff+1] = d[roff+1];
+
+			// eliminate interface sub-diagonal
+			for(size_t i=2; i<sub_size; ++i) {
+				const real_t ratio = -1.0*e[roff+i-1]/ib[lroff+1];
+
+				ib[lroff+1] = ratio*e[roff+i-1] + b[roff+i];
+				id[lroff+1] = ratio*id[lroff+1] + d[roff+i];
+			} // for
+
+			ib[lroff] = b[roff+sub_size-2];
+			ic[lroff] = e[roff+sub_size-2];
+			id[lroff] = d[roff+sub_size-2];
+
+			// eliminate interface super-diagonal
+			for(size_t i=sub_size-2; i != 0; --i) {
+				const real_t ratio = -1.0*e[roff+i-1]/ib[lroff];
+
+				ib[lroff] = ratio*e[roff+i-1] + b[roff+i-1];
+				ic[lroff] = ratio*ic[lroff];
+				id[lroff] = ratio*id[lroff] + d[roff+i-1];
+			} // for
+		} // for
+	} // for
+
+	return interface;
+} // create_symmetric_interface_system
+
 /*----------------------------------------------------------------------------*
  * Create device buffers.
  *----------------------------------------------------------------------------*/
 
 template<typename real_t>
-void
+int32_t
 TriCyCL<real_t>::create_buffer(cl_context & context, cl_mem_flags flags,
 	size_t bytes, cl_mem & d_p, void * h_p) {
 	CALLER_SELF
@@ -654,8 +5330,11 @@ TriCyCL<real_t>::create_buffer(cl_context & context, cl_mem_flags flags,
 	d_p = clCreateBuffer(context, flags, bytes, h_p, &ierr);
 
 	if(ierr != CL_SUCCESS) {
-		CL_ABORTerr(clCreateBuffer, ierr);
+		d_p = NULL;
+		CL_RETURNerr(clCreateBuffer, ierr, ierr);
 	} // if
+
+	return CL_SUCCESS;
 } // create_buffer
 
 /*----------------------------------------------------------------------------*
@@ -668,6 +5347,24 @@ TriCyCL<real_t>::get_device_info(cl_device_id & id) {
 	CALLER_SELF
 	device_info_t info;
 	
+	char version[256];
+
+	CL_CHECKerr(clGetDeviceInfo, id, CL_DEVICE_NAME,
+		sizeof(info.name), info.name, NULL);
+
+	CL_CHECKerr(clGetDeviceInfo, id, CL_DEVICE_VERSION,
+		sizeof(version), version, NULL);
+
+	// "OpenCL <major>.<minor> <vendor-specific information>"
+	if(sscanf(version, "OpenCL %u.%u", &info.version_major,
+		&info.version_minor) != 2) {
+		info.version_major = 1;
+		info.version_minor = 0;
+	} // if
+
+	CL_CHECKerr(clGetDeviceInfo, id, CL_DEVICE_TYPE,
+		sizeof(info.type), &info.type, NULL);
+
 	CL_CHECKerr(clGetDeviceInfo, id, CL_DEVICE_VENDOR_ID,
 		sizeof(info.vendor_id), &info.vendor_id, NULL);
 
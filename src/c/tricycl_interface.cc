@@ -4,6 +4,10 @@
 #include <tricycl.hh>
 #include <tricycl.h>
 
+#if defined(ENABLE_TRICYCL_MPI)
+#include <tricycl_mpi.h>
+#endif
+
 TriCyCL<float> & sp = TriCyCL<float>::instance();
 TriCyCL<double> & dp = TriCyCL<double>::instance();
 
@@ -52,3 +56,331 @@ int32_t tricycl_solve_dp(size_t token, size_t system_size, size_t num_systems,
 	double * a, double * b, double * c, double * d, double * x) {
 	return dp.solve(token, system_size, num_systems, a, b, c, d, x);
 } // tricycl_solve_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision in-place solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_inplace_sp(size_t token, size_t system_size,
+	size_t num_systems, float * a, float * b, float * c, float * d) {
+	return sp.solve(token, system_size, num_systems, a, b, c, d, d);
+} // tricycl_solve_inplace_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision in-place solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_inplace_dp(size_t token, size_t system_size,
+	size_t num_systems, double * a, double * b, double * c, double * d) {
+	return dp.solve(token, system_size, num_systems, a, b, c, d, d);
+} // tricycl_solve_inplace_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision truncated solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_truncated_sp(size_t token, size_t system_size,
+	size_t num_systems, float * a, float * b, float * c, float * d,
+	float * x, double tolerance, double * bound) {
+	return sp.solve_truncated(token, system_size, num_systems, a, b, c, d, x,
+		tolerance, bound);
+} // tricycl_solve_truncated_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision truncated solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_truncated_dp(size_t token, size_t system_size,
+	size_t num_systems, double * a, double * b, double * c, double * d,
+	double * x, double tolerance, double * bound) {
+	return dp.solve_truncated(token, system_size, num_systems, a, b, c, d, x,
+		tolerance, bound);
+} // tricycl_solve_truncated_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision solver with residual norms
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_residual_sp(size_t token, size_t system_size,
+	size_t num_systems, float * a, float * b, float * c, float * d,
+	float * x, float * norms) {
+	return sp.solve_residual(token, system_size, num_systems, a, b, c, d, x,
+		norms);
+} // tricycl_solve_residual_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision solver with residual norms
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_residual_dp(size_t token, size_t system_size,
+	size_t num_systems, double * a, double * b, double * c, double * d,
+	double * x, double * norms) {
+	return dp.solve_residual(token, system_size, num_systems, a, b, c, d, x,
+		norms);
+} // tricycl_solve_residual_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision grid solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_grid_sp(size_t token, const tricycl_grid_t * grid,
+	float * a, float * b, float * c, float * d, float * x) {
+	if(grid == NULL) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	return sp.solve_grid(token, *grid, a, b, c, d, x);
+} // tricycl_solve_grid_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision grid solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_grid_dp(size_t token, const tricycl_grid_t * grid,
+	double * a, double * b, double * c, double * d, double * x) {
+	if(grid == NULL) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	return dp.solve_grid(token, *grid, a, b, c, d, x);
+} // tricycl_solve_grid_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision ragged solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_ragged_sp(size_t token, size_t num_systems,
+	const size_t * offsets, float * a, float * b, float * c, float * d,
+	float * x) {
+	return sp.solve_ragged(token, num_systems, offsets, a, b, c, d, x);
+} // tricycl_solve_ragged_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision ragged solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_ragged_dp(size_t token, size_t num_systems,
+	const size_t * offsets, double * a, double * b, double * c, double * d,
+	double * x) {
+	return dp.solve_ragged(token, num_systems, offsets, a, b, c, d, x);
+} // tricycl_solve_ragged_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision symmetric solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_symmetric_sp(size_t token, size_t system_size,
+	size_t num_systems, float * b, float * e, float * d, float * x) {
+	return sp.solve_symmetric(token, system_size, num_systems, b, e, d, x);
+} // tricycl_solve_symmetric_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision symmetric solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_symmetric_dp(size_t token, size_t system_size,
+	size_t num_systems, double * b, double * e, double * d, double * x) {
+	return dp.solve_symmetric(token, system_size, num_systems, b, e, d, x);
+} // tricycl_solve_symmetric_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision packed solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_packed_sp(size_t token, size_t system_size,
+	size_t num_systems, const float * rows, float * x) {
+	return sp.solve_packed(token, system_size, num_systems, rows, x);
+} // tricycl_solve_packed_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision packed solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_packed_dp(size_t token, size_t system_size,
+	size_t num_systems, const double * rows, double * x) {
+	return dp.solve_packed(token, system_size, num_systems, rows, x);
+} // tricycl_solve_packed_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision line smoother
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_smooth_sp(size_t token, size_t system_size,
+	size_t num_lines, const float * a, const float * b, const float * c,
+	const float * s, const float * n, const float * f, float * u,
+	float omega, size_t sweeps) {
+	return sp.smooth(token, system_size, num_lines, a, b, c, s, n, f, u,
+		omega, sweeps);
+} // tricycl_smooth_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision line smoother
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_smooth_dp(size_t token, size_t system_size,
+	size_t num_lines, const double * a, const double * b, const double * c,
+	const double * s, const double * n, const double * f, double * u,
+	double omega, size_t sweeps) {
+	return dp.smooth(token, system_size, num_lines, a, b, c, s, n, f, u,
+		omega, sweeps);
+} // tricycl_smooth_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision selective solves
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_batch_create_sp(size_t token, size_t system_size,
+	size_t num_systems, const float * a, const float * b, const float * c,
+	const float * d, size_t * batch) {
+	if(batch == NULL) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	return sp.batch_create(token, system_size, num_systems, a, b, c, d,
+		*batch);
+} // tricycl_batch_create_sp
+
+int32_t tricycl_batch_update_sp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, const float * a,
+	const float * b, const float * c, const float * d) {
+	return sp.batch_update(token, batch, num_active, active, a, b, c, d);
+} // tricycl_batch_update_sp
+
+int32_t tricycl_batch_solve_sp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, float * x) {
+	return sp.batch_solve(token, batch, num_active, active, x);
+} // tricycl_batch_solve_sp
+
+int32_t tricycl_batch_destroy_sp(size_t token, size_t batch) {
+	return sp.batch_destroy(token, batch);
+} // tricycl_batch_destroy_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision selective solves
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_batch_create_dp(size_t token, size_t system_size,
+	size_t num_systems, const double * a, const double * b, const double * c,
+	const double * d, size_t * batch) {
+	if(batch == NULL) {
+		return TRICYCL_INVALID_VALUE;
+	} // if
+
+	return dp.batch_create(token, system_size, num_systems, a, b, c, d,
+		*batch);
+} // tricycl_batch_create_dp
+
+int32_t tricycl_batch_update_dp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, const double * a,
+	const double * b, const double * c, const double * d) {
+	return dp.batch_update(token, batch, num_active, active, a, b, c, d);
+} // tricycl_batch_update_dp
+
+int32_t tricycl_batch_solve_dp(size_t token, size_t batch,
+	size_t num_active, const uint32_t * active, double * x) {
+	return dp.batch_solve(token, batch, num_active, active, x);
+} // tricycl_batch_solve_dp
+
+int32_t tricycl_batch_destroy_dp(size_t token, size_t batch) {
+	return dp.batch_destroy(token, batch);
+} // tricycl_batch_destroy_dp
+
+/*----------------------------------------------------------------------------*
+ * Single-precision deferred solves
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_batch_begin_sp(size_t token) {
+	return sp.batch_begin(token);
+} // tricycl_batch_begin_sp
+
+int32_t tricycl_batch_add_sp(size_t token, size_t system_size,
+	size_t num_systems, const float * a, const float * b, const float * c,
+	const float * d, float * x) {
+	return sp.batch_add(token, system_size, num_systems, a, b, c, d, x);
+} // tricycl_batch_add_sp
+
+int32_t tricycl_batch_flush_sp(size_t token) {
+	return sp.batch_flush(token);
+} // tricycl_batch_flush_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision deferred solves
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_batch_begin_dp(size_t token) {
+	return dp.batch_begin(token);
+} // tricycl_batch_begin_dp
+
+int32_t tricycl_batch_add_dp(size_t token, size_t system_size,
+	size_t num_systems, const double * a, const double * b,
+	const double * c, const double * d, double * x) {
+	return dp.batch_add(token, system_size, num_systems, a, b, c, d, x);
+} // tricycl_batch_add_dp
+
+int32_t tricycl_batch_flush_dp(size_t token) {
+	return dp.batch_flush(token);
+} // tricycl_batch_flush_dp
+
+#if defined(ENABLE_TRICYCL_MPI)
+/*----------------------------------------------------------------------------*
+ * Single-precision distributed solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_mpi_sp(size_t token, MPI_Comm comm, size_t local_size,
+	size_t num_systems, float * a, float * b, float * c, float * d,
+	float * x) {
+	return sp.solve_mpi(token, comm, local_size, num_systems,
+		a, b, c, d, x);
+} // tricycl_solve_mpi_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision distributed solver
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_solve_mpi_dp(size_t token, MPI_Comm comm, size_t local_size,
+	size_t num_systems, double * a, double * b, double * c, double * d,
+	double * x) {
+	return dp.solve_mpi(token, comm, local_size, num_systems,
+		a, b, c, d, x);
+} // tricycl_solve_mpi_dp
+#endif
+
+/*----------------------------------------------------------------------------*
+ * Single-precision tuning
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_tune_sp(size_t token, size_t system_size,
+	size_t num_systems) {
+	tuning_t tuning;
+	return sp.tune(token, system_size, num_systems, tuning);
+} // tricycl_tune_sp
+
+/*----------------------------------------------------------------------------*
+ * Double-precision tuning
+ *----------------------------------------------------------------------------*/
+
+int32_t tricycl_tune_dp(size_t token, size_t system_size,
+	size_t num_systems) {
+	tuning_t tuning;
+	return dp.tune(token, system_size, num_systems, tuning);
+} // tricycl_tune_dp
+
+/*----------------------------------------------------------------------------*
+ * Statistics
+ *----------------------------------------------------------------------------*/
+
+void tricycl_get_stats(tricycl_stats_t * stats) {
+	Stats::instance().get(*stats);
+} // tricycl_get_stats
+
+void tricycl_reset_stats() {
+	Stats::instance().reset();
+} // tricycl_reset_stats
+
+int32_t tricycl_write_trace(const char * filename) {
+	return Stats::instance().write_trace(filename) ? 0 : 1;
+} // tricycl_write_trace
+
+const char * tricycl_phase_name(int32_t phase) {
+	return Stats::phase_name(phase);
+} // tricycl_phase_name
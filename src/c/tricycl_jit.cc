@@ -0,0 +1,150 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL cache of shape-specialized programs.
+ *----------------------------------------------------------------------------*/
+
+#define _tricycl_source
+
+#include <tricycl_utils.h>
+#include <tricycl_jit.hh>
+
+/*----------------------------------------------------------------------------*
+ * Destructor.
+ *----------------------------------------------------------------------------*/
+
+JITCache::~JITCache() {
+	for(std::list<entry_t *>::iterator ita = entries_.begin();
+		ita != entries_.end(); ++ita) {
+		// the build callback still refers to these
+		if((*ita)->status != building) {
+			release(*ita);
+		} // if
+	} // for
+} // JITCache::~JITCache
+
+/*----------------------------------------------------------------------------*
+ * Acquire.
+ *----------------------------------------------------------------------------*/
+
+cl_program
+JITCache::acquire(const key_t & key, cl_device_id id, entry_t *& created) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	entry_t * entry = find(key);
+
+	created = NULL;
+
+	if(entry == NULL) {
+		created = insert(key, id);
+		return NULL;
+	} // if
+
+	if(entry->status != ready) {
+		return NULL;
+	} // if
+
+	// keeps the program alive if another thread evicts the entry
+	clRetainProgram(entry->program);
+
+	return entry->program;
+} // JITCache::acquire
+
+/*----------------------------------------------------------------------------*
+ * Find.
+ *----------------------------------------------------------------------------*/
+
+JITCache::entry_t *
+JITCache::find(const key_t & key) {
+	std::map<key_t, std::list<entry_t *>::iterator>::iterator ita =
+		index_.find(key);
+
+	if(ita == index_.end()) {
+		return NULL;
+	} // if
+
+	entries_.splice(entries_.begin(), entries_, ita->second);
+
+	return *ita->second;
+} // JITCache::find
+
+/*----------------------------------------------------------------------------*
+ * Insert.
+ *----------------------------------------------------------------------------*/
+
+JITCache::entry_t *
+JITCache::insert(const key_t & key, cl_device_id id) {
+	entry_t * entry = new entry_t(key, id);
+
+	entries_.push_front(entry);
+	index_[key] = entries_.begin();
+
+	// evict from the least recently used end
+	std::list<entry_t *>::iterator ita = entries_.end();
+
+	while(entries_.size() > capacity_ && ita != entries_.begin()) {
+		--ita;
+
+		if((*ita)->status == building || *ita == entry) {
+			continue;
+		} // if
+
+		message("Evicting specialized program for system size %d\n",
+			(int)(*ita)->key.system_size);
+
+		index_.erase((*ita)->key);
+		release(*ita);
+		ita = entries_.erase(ita);
+	} // while
+
+	return entry;
+} // JITCache::insert
+
+/*----------------------------------------------------------------------------*
+ * Building count.
+ *----------------------------------------------------------------------------*/
+
+size_t
+JITCache::building_count() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t count(0);
+
+	for(std::list<entry_t *>::const_iterator ita = entries_.begin();
+		ita != entries_.end(); ++ita) {
+		if((*ita)->status == building) {
+			++count;
+		} // if
+	} // for
+
+	return count;
+} // JITCache::building_count
+
+/*----------------------------------------------------------------------------*
+ * Build callback.
+ *----------------------------------------------------------------------------*/
+
+void CL_CALLBACK
+JITCache::notify(cl_program program, void * user_data) {
+	entry_t * entry = reinterpret_cast<entry_t *>(user_data);
+	cl_build_status status = CL_BUILD_ERROR;
+
+	clGetProgramBuildInfo(program, entry->id, CL_PROGRAM_BUILD_STATUS,
+		sizeof(cl_build_status), &status, NULL);
+
+	if(status != CL_BUILD_SUCCESS) {
+		warning("Specialized build for system size %d failed\n",
+			(int)entry->key.system_size);
+	} // if
+
+	entry->status = status == CL_BUILD_SUCCESS ? ready : failed;
+} // JITCache::notify
+
+/*----------------------------------------------------------------------------*
+ * Release.
+ *----------------------------------------------------------------------------*/
+
+void
+JITCache::release(entry_t * entry) {
+	if(entry->program != NULL) {
+		clReleaseProgram(entry->program);
+	} // if
+
+	delete entry;
+} // JITCache::release
@@ -0,0 +1,118 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL cache of shape-specialized programs.
+ *----------------------------------------------------------------------------*/
+
+#ifndef tricycl_jit_hh
+#define tricycl_jit_hh
+
+#include <list>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+
+#define _include_tricycl_h
+
+#include <tricycl_local.h>
+
+/*----------------------------------------------------------------------------*
+ * Least-recently-used cache of PCR programs compiled with SYSTEM_SIZE and
+ * ITERATIONS defined.  Programs are built asynchronously; an entry can only
+ * be used once its status is ready, and entries that are still building are
+ * never evicted (the build callback holds a pointer to them).
+ *
+ * The cache is shared by all host threads.  Kernels are not stored here
+ * because kernel arguments are per-object state: each thread creates its
+ * own kernel from the program returned by acquire.
+ *----------------------------------------------------------------------------*/
+
+class JITCache
+{
+public:
+
+	enum status_t {
+		building = 0,
+		ready = 1,
+		failed = 2
+	}; // enum status_t
+
+	/*-------------------------------------------------------------------------*
+	 * Cache key.
+	 *-------------------------------------------------------------------------*/
+
+	struct key_t {
+		size_t system_size;
+		bool native_divide;
+
+		key_t(size_t _system_size, bool _native_divide)
+			: system_size(_system_size), native_divide(_native_divide) {}
+
+		bool operator < (const key_t & k) const {
+			if(system_size != k.system_size) {
+				return system_size < k.system_size;
+			} // if
+
+			return native_divide < k.native_divide;
+		} // operator <
+	}; // struct key_t
+
+	/*-------------------------------------------------------------------------*
+	 * Cache entry.
+	 *-------------------------------------------------------------------------*/
+
+	struct entry_t {
+		key_t key;
+		cl_device_id id;
+		cl_program program;
+		std::atomic<int> status;
+
+		entry_t(const key_t & _key, cl_device_id _id)
+			: key(_key), id(_id), program(NULL), status(building) {}
+	}; // struct entry_t
+
+	JITCache(size_t capacity)
+		: capacity_(capacity) {}
+
+	~JITCache();
+
+	/*-------------------------------------------------------------------------*
+	 * Look up a key and mark it most recently used.  Returns the program,
+	 * retained for the caller, if it is ready and NULL otherwise.  If the
+	 * key was not cached a new entry in the building state is returned in
+	 * created, and the caller must start its build.
+	 *-------------------------------------------------------------------------*/
+
+	cl_program acquire(const key_t & key, cl_device_id id,
+		entry_t *& created);
+
+	/*-------------------------------------------------------------------------*
+	 * Number of entries still building.
+	 *-------------------------------------------------------------------------*/
+
+	size_t building_count() const;
+
+	/*-------------------------------------------------------------------------*
+	 * clBuildProgram callback, user_data is the entry_t.
+	 *-------------------------------------------------------------------------*/
+
+	static void CL_CALLBACK notify(cl_program program, void * user_data);
+
+private:
+
+	JITCache(const JITCache &) {}
+	JITCache & operator = (const JITCache &);
+
+	entry_t * find(const key_t & key);
+	entry_t * insert(const key_t & key, cl_device_id id);
+	void release(entry_t * entry);
+
+	size_t capacity_;
+	mutable std::mutex mutex_;
+
+	// most recently used first
+	std::list<entry_t *> entries_;
+	std::map<key_t, std::list<entry_t *>::iterator> index_;
+
+}; // class JITCache
+
+#endif // tricycl_jit_hh
@@ -0,0 +1,50 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL MPI interface (requires --enable-tricycl_mpi).
+ *----------------------------------------------------------------------------*/
+
+#ifndef tricycl_mpi_h
+#define tricycl_mpi_h
+
+#include <mpi.h>
+
+#include <tricycl.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*!
+\page tricycl_solve_mpi_sp
+
+Solves num_systems systems whose rows are split across the ranks of comm:
+rank p holds local_size consecutive rows of every system (stored as for
+tricycl_solve_sp), and the chunks follow rank order.  local_size may
+differ between ranks but must be at least 2.  Each rank reduces its
+chunk to two interface rows per system on the host (a single pass over
+the chunk, as for the interface system of a partitioned solve), rank 0
+solves the gathered interface systems, and each rank then solves its
+chunk on its own token.
+Collective over comm; every rank returns the same error code for
+argument and allocation errors.  Rows of a, b, c and d are modified
+during the call and restored before it returns.
+
+\par Interface:
+ */
+int32_t tricycl_solve_mpi_sp(size_t token, MPI_Comm comm, size_t local_size,
+	size_t num_systems, float * a, float * b, float * c, float * d,
+	float * x);
+
+/*!
+\page tricycl_solve_mpi_dp
+
+\par Interface:
+ */
+int32_t tricycl_solve_mpi_dp(size_t token, MPI_Comm comm, size_t local_size,
+	size_t num_systems, double * a, double * b, double * c, double * d,
+	double * x);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // tricycl_mpi_h
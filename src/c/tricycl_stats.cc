@@ -0,0 +1,220 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL solve statistics.
+ *----------------------------------------------------------------------------*/
+
+#define _tricycl_source
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <tricycl_utils.h>
+#include <tricycl_stats.hh>
+
+/*----------------------------------------------------------------------------*
+ * Constructor.
+ *----------------------------------------------------------------------------*/
+
+Stats::Stats()
+	: origin_(now()) {
+	std::memset(&stats_, 0, sizeof(tricycl_stats_t));
+} // Stats::Stats
+
+/*----------------------------------------------------------------------------*
+ * Destructor (runs at exit).
+ *----------------------------------------------------------------------------*/
+
+Stats::~Stats() {
+	if(std::getenv("TRICYCL_STATS") != nullptr && stats_.solves > 0) {
+		summary(stderr);
+	} // if
+
+	const char * trace_file = std::getenv("TRICYCL_TRACE");
+
+	if(trace_file != nullptr && !write_trace(trace_file)) {
+		error("Failed writing trace to %s\n", trace_file);
+	} // if
+} // Stats::~Stats
+
+/*----------------------------------------------------------------------------*
+ * Phase.
+ *----------------------------------------------------------------------------*/
+
+void
+Stats::phase(tricycl_phase_t phase, const time_point_t & start,
+	const time_point_t & end, size_t num_events, const cl_event * events) {
+	if(paused_()) {
+		return;
+	} // if
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	const double host_start = microseconds(start);
+	const double host_duration = microseconds(end) - host_start;
+
+	stats_.phases[phase].calls++;
+	stats_.phases[phase].wall_seconds += 1.0e-6*host_duration;
+	trace(phase, 0, host_start, host_duration);
+
+	cl_ulong queued(0), device_start(0), device_end(0);
+
+	for(size_t i(0); i<num_events; ++i) {
+		cl_ulong t[3];
+		int32_t ierr = 0;
+
+		ierr |= clGetEventProfilingInfo(events[i], CL_PROFILING_COMMAND_QUEUED,
+			sizeof(cl_ulong), &t[0], NULL);
+		ierr |= clGetEventProfilingInfo(events[i], CL_PROFILING_COMMAND_START,
+			sizeof(cl_ulong), &t[1], NULL);
+		ierr |= clGetEventProfilingInfo(events[i], CL_PROFILING_COMMAND_END,
+			sizeof(cl_ulong), &t[2], NULL);
+
+		// queue was created without CL_QUEUE_PROFILING_ENABLE
+		if(ierr != CL_SUCCESS) {
+			return;
+		} // if
+
+		queued = i == 0 ? t[0] : std::min(queued, t[0]);
+		device_start = i == 0 ? t[1] : std::min(device_start, t[1]);
+		device_end = i == 0 ? t[2] : std::max(device_end, t[2]);
+	} // for
+
+	if(num_events == 0) {
+		return;
+	} // if
+
+	stats_.phases[phase].device_seconds += 1.0e-9*(device_end - device_start);
+
+	// device clocks are not comparable with the host, so place the device
+	// slice relative to the host enqueue
+	trace(phase, 1, host_start + 1.0e-3*(device_start - queued),
+		1.0e-3*(device_end - device_start));
+} // Stats::phase
+
+/*----------------------------------------------------------------------------*
+ * Solve.
+ *----------------------------------------------------------------------------*/
+
+void
+Stats::solve(const time_point_t & start, const time_point_t & end,
+	size_t system_size, size_t num_systems, size_t sub_size,
+	size_t sub_iterations, size_t interface_size,
+	size_t interface_iterations) {
+	if(paused_()) {
+		return;
+	} // if
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	stats_.solves++;
+	stats_.host_solves += sub_size == 0 ? 1 : 0;
+	stats_.wall_seconds +=
+		std::chrono::duration<double>(end - start).count();
+
+	stats_.system_size = system_size;
+	stats_.num_systems = num_systems;
+	stats_.sub_size = sub_size;
+	stats_.sub_iterations = sub_iterations;
+	stats_.interface_size = interface_size;
+	stats_.interface_iterations = interface_iterations;
+} // Stats::solve
+
+/*----------------------------------------------------------------------------*
+ * Reset.
+ *----------------------------------------------------------------------------*/
+
+void
+Stats::reset() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::memset(&stats_, 0, sizeof(tricycl_stats_t));
+	trace_.clear();
+	origin_ = now();
+} // Stats::reset
+
+/*----------------------------------------------------------------------------*
+ * Summary.
+ *----------------------------------------------------------------------------*/
+
+void
+Stats::summary(FILE * stream) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	fprintf(stream, "TriCyCL: %llu solves (%llu on host, %llu device "
+		"failures) in %.6f s\n", (unsigned long long)stats_.solves,
+		(unsigned long long)stats_.host_solves,
+		(unsigned long long)stats_.device_failures, stats_.wall_seconds);
+	fprintf(stream, "  %-14s %10s %14s %14s\n", "phase", "calls",
+		"wall (s)", "device (s)");
+
+	for(int32_t p(0); p<TRICYCL_NUM_PHASES; ++p) {
+		fprintf(stream, "  %-14s %10llu %14.6f %14.6f\n", phase_name(p),
+			(unsigned long long)stats_.phases[p].calls,
+			stats_.phases[p].wall_seconds, stats_.phases[p].device_seconds);
+	} // for
+
+	fprintf(stream, "  bytes to device %llu, from device %llu\n",
+		(unsigned long long)stats_.bytes_to_device,
+		(unsigned long long)stats_.bytes_from_device);
+	fprintf(stream, "  last solve: system_size %llu num_systems %llu "
+		"sub_size %llu interface_size %llu\n",
+		(unsigned long long)stats_.system_size,
+		(unsigned long long)stats_.num_systems,
+		(unsigned long long)stats_.sub_size,
+		(unsigned long long)stats_.interface_size);
+} // Stats::summary
+
+/*----------------------------------------------------------------------------*
+ * Write Chrome trace.
+ *----------------------------------------------------------------------------*/
+
+bool
+Stats::write_trace(const char * filename) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	FILE * file = fopen(filename, "w");
+
+	if(file == NULL) {
+		return false;
+	} // if
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+		"\"tid\":0,\"args\":{\"name\":\"host\"}},\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+		"\"tid\":1,\"args\":{\"name\":\"device\"}}");
+
+	for(size_t i(0); i<trace_.size(); ++i) {
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"tricycl\",\"ph\":\"X\","
+			"\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}",
+			phase_name(trace_[i].phase), trace_[i].start, trace_[i].duration,
+			trace_[i].track);
+	} // for
+
+	fprintf(file, "\n]}\n");
+
+	return fclose(file) == 0;
+} // Stats::write_trace
+
+/*----------------------------------------------------------------------------*
+ * Phase name.
+ *----------------------------------------------------------------------------*/
+
+const char *
+Stats::phase_name(int32_t phase) {
+	switch(phase) {
+		case TRICYCL_PHASE_INTERFACE:
+			return "interface";
+		case TRICYCL_PHASE_UPLOAD:
+			return "upload";
+		case TRICYCL_PHASE_INTERFACE_PCR:
+			return "interface_pcr";
+		case TRICYCL_PHASE_UNCOUPLE:
+			return "uncouple";
+		case TRICYCL_PHASE_PCR:
+			return "pcr";
+		case TRICYCL_PHASE_READBACK:
+			return "readback";
+		case TRICYCL_PHASE_HOST:
+			return "host";
+		case TRICYCL_PHASE_RESIDUAL:
+			return "residual";
+		default:
+			return "unknown";
+	} // switch
+} // Stats::phase_name
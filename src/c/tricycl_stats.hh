@@ -0,0 +1,161 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL solve statistics.
+ *----------------------------------------------------------------------------*/
+
+#ifndef tricycl_stats_hh
+#define tricycl_stats_hh
+
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+#include <tricycl.h>
+
+/*----------------------------------------------------------------------------*
+ * Accumulated per-phase timings and transfer counts for all solves.
+ *
+ * Host wall time is always recorded.  Device time is read from the phase
+ * events, so it is only available when the command queue was created with
+ * CL_QUEUE_PROFILING_ENABLE.  Each phase is also kept as a trace event
+ * (up to max_trace_events) for tricycl_write_trace.  Recording is
+ * serialized by a mutex, held only while the counters are updated.
+ *----------------------------------------------------------------------------*/
+
+class Stats
+{
+public:
+
+	typedef std::chrono::steady_clock clock_t;
+	typedef clock_t::time_point time_point_t;
+
+	static const size_t max_trace_events = 65536;
+
+	/*-------------------------------------------------------------------------*
+	 * Meyer's singleton instance method.
+	 *-------------------------------------------------------------------------*/
+
+	static Stats & instance() {
+		static Stats stats;
+		return stats;
+	} // instance
+
+	static time_point_t now() { return clock_t::now(); }
+
+	/*-------------------------------------------------------------------------*
+	 * Record one phase.  The device time spans the first start to the last
+	 * end of the given events; it is skipped for host-only phases and for
+	 * events without profiling information.  Paths that enqueue several
+	 * phases and wait once book the wall time to the main phase and record
+	 * the others with start == end, keeping only their device time.
+	 *-------------------------------------------------------------------------*/
+
+	void phase(tricycl_phase_t phase, const time_point_t & start,
+		const time_point_t & end, size_t num_events = 0,
+		const cl_event * events = NULL);
+
+	/*-------------------------------------------------------------------------*
+	 * Record a completed solve and the parameters that were used.
+	 *-------------------------------------------------------------------------*/
+
+	void solve(const time_point_t & start, const time_point_t & end,
+		size_t system_size, size_t num_systems, size_t sub_size,
+		size_t sub_iterations, size_t interface_size,
+		size_t interface_iterations);
+
+	/*-------------------------------------------------------------------------*
+	 * Stop recording on the calling thread (e.g. for calibration solves).
+	 *-------------------------------------------------------------------------*/
+
+	void pause(bool paused) { paused_() = paused; }
+
+	void device_failure() {
+		if(paused_()) {
+			return;
+		} // if
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats_.device_failures++;
+	} // device_failure
+
+	void bytes(size_t to_device, size_t from_device) {
+		if(paused_()) {
+			return;
+		} // if
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats_.bytes_to_device += to_device;
+		stats_.bytes_from_device += from_device;
+	} // bytes
+
+	/*-------------------------------------------------------------------------*
+	 * Access.
+	 *-------------------------------------------------------------------------*/
+
+	void get(tricycl_stats_t & stats) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats = stats_;
+	} // get
+
+	void reset();
+
+	void summary(FILE * stream) const;
+	bool write_trace(const char * filename) const;
+
+	static const char * phase_name(int32_t phase);
+
+private:
+
+	/*-------------------------------------------------------------------------*
+	 * Trace event, times in microseconds from the construction of Stats.
+	 *-------------------------------------------------------------------------*/
+
+	struct trace_event_t {
+		int32_t phase;
+		int32_t track; // 0 host, 1 device
+		double start;
+		double duration;
+
+		trace_event_t(int32_t _phase, int32_t _track, double _start,
+			double _duration)
+			: phase(_phase), track(_track), start(_start),
+			duration(_duration) {}
+	}; // struct trace_event_t
+
+	/*-------------------------------------------------------------------------*
+	 * Hide these.
+	 *-------------------------------------------------------------------------*/
+
+	Stats();
+	Stats(const Stats &) {}
+	Stats & operator = (const Stats &);
+
+	~Stats();
+
+	static bool & paused_() {
+		static thread_local bool paused(false);
+		return paused;
+	} // paused_
+
+	double microseconds(const time_point_t & t) const {
+		return std::chrono::duration<double, std::micro>(t - origin_).count();
+	} // microseconds
+
+	void trace(int32_t phase, int32_t track, double start, double duration) {
+		if(trace_.size() < max_trace_events) {
+			trace_.push_back(trace_event_t(phase, track, start, duration));
+		} // if
+	} // trace
+
+	/*-------------------------------------------------------------------------*
+	 * Private data members.
+	 *-------------------------------------------------------------------------*/
+
+	mutable std::mutex mutex_;
+	time_point_t origin_;
+	tricycl_stats_t stats_;
+	std::vector<trace_event_t> trace_;
+
+}; // class Stats
+
+#endif // tricycl_stats_hh
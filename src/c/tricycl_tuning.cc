@@ -0,0 +1,158 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL tuning database.
+ *----------------------------------------------------------------------------*/
+
+#define _tricycl_source
+
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <tricycl_utils.h>
+#include <tricycl_tuning.hh>
+
+/*----------------------------------------------------------------------------*
+ * Load.
+ *----------------------------------------------------------------------------*/
+
+void
+TuningDB::load() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	load_locked();
+} // TuningDB::load
+
+void
+TuningDB::load_locked() {
+	if(loaded_) {
+		return;
+	} // if
+
+	loaded_ = true;
+
+	const char * env = std::getenv("TRICYCL_TUNING_FILE");
+	filename_ = env != nullptr ? env : "tricycl_tuning.dat";
+
+	std::ifstream file(filename_.c_str());
+
+	if(!file.good()) {
+		return;
+	} // if
+
+	std::string line;
+	while(std::getline(file, line)) {
+		if(line.empty() || line[0] == '#') {
+			continue;
+		} // if
+
+		std::istringstream fields(line);
+		std::string device, precision;
+		size_t system_size, num_systems;
+		uint32_t native_divide, variant;
+		tuning_t tuning;
+
+		fields >> device >> precision >> system_size >> num_systems >>
+			tuning.sub_size >> native_divide >> variant >> tuning.seconds;
+
+		if(fields.fail() || variant >= pcr_num_variants) {
+			warning("Ignoring malformed line in %s: %s\n",
+				filename_.c_str(), line.c_str());
+			continue;
+		} // if
+
+		tuning.native_divide = native_divide != 0;
+		tuning.variant = static_cast<pcr_variant_t>(variant);
+
+		// files written before rows was added have one row per work-item
+		if(!(fields >> tuning.rows)) {
+			tuning.rows = 1;
+		} // if
+
+		entries_[key_t(device, precision, system_size, num_systems)] = tuning;
+	} // while
+
+	message("Loaded %d tuning entries from %s\n", (int)entries_.size(),
+		filename_.c_str());
+} // TuningDB::load_locked
+
+/*----------------------------------------------------------------------------*
+ * Save.
+ *----------------------------------------------------------------------------*/
+
+void
+TuningDB::save() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	load_locked();
+
+	// write a temporary and rename it so readers never see a partial file
+	const std::string tmp = filename_ + ".tmp";
+	std::ofstream file(tmp.c_str());
+
+	if(!file.good()) {
+		error("Failed opening %s for writing\n", tmp.c_str());
+		return;
+	} // if
+
+	file << "# TriCyCL tuning database" << std::endl;
+	file << "# device precision system_size num_systems sub_size " <<
+		"native_divide variant seconds rows" << std::endl;
+
+	for(std::map<key_t, tuning_t>::const_iterator ita = entries_.begin();
+		ita != entries_.end(); ++ita) {
+		file << ita->first.device << " " << ita->first.precision << " " <<
+			ita->first.system_size << " " << ita->first.num_systems << " " <<
+			ita->second.sub_size << " " << ita->second.native_divide << " " <<
+			ita->second.variant << " " << ita->second.seconds << " " <<
+			ita->second.rows << std::endl;
+	} // for
+
+	file.close();
+
+	if(std::rename(tmp.c_str(), filename_.c_str()) != 0) {
+		error("Failed writing %s\n", filename_.c_str());
+	} // if
+} // TuningDB::save
+
+/*----------------------------------------------------------------------------*
+ * Find.
+ *----------------------------------------------------------------------------*/
+
+bool
+TuningDB::find(const key_t & key, tuning_t & tuning) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::map<key_t, tuning_t>::const_iterator ita = entries_.find(key);
+
+	if(ita == entries_.end()) {
+		return false;
+	} // if
+
+	tuning = ita->second;
+	return true;
+} // TuningDB::find
+
+/*----------------------------------------------------------------------------*
+ * Insert.
+ *----------------------------------------------------------------------------*/
+
+void
+TuningDB::insert(const key_t & key, const tuning_t & tuning) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_[key] = tuning;
+} // TuningDB::insert
+
+/*----------------------------------------------------------------------------*
+ * Device key.
+ *----------------------------------------------------------------------------*/
+
+std::string
+TuningDB::device_key(const char * name) {
+	std::string key(name);
+
+	for(size_t i(0); i<key.size(); ++i) {
+		if(key[i] == ' ' || key[i] == '\t') {
+			key[i] = '_';
+		} // if
+	} // for
+
+	return key.empty() ? std::string("unknown") : key;
+} // TuningDB::device_key
@@ -0,0 +1,168 @@
+/*----------------------------------------------------------------------------*
+ * TriCyCL tuning database.
+ *----------------------------------------------------------------------------*/
+
+#ifndef tricycl_tuning_hh
+#define tricycl_tuning_hh
+
+#include <map>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*----------------------------------------------------------------------------*
+ * PCR kernel variants.  pcr_adaptive stops reducing once the off-diagonals
+ * are below working precision.
+ *----------------------------------------------------------------------------*/
+
+enum pcr_variant_t {
+	pcr_branch_free = 0,
+	pcr_adaptive = 1,
+	pcr_num_variants
+}; // enum pcr_variant_t
+
+/*----------------------------------------------------------------------------*
+ * Solver parameters for one problem shape.
+ *
+ * The sub-system solve runs rows rows per work-item, so its work group
+ * size is sub_size/rows.  With more than one row per work-item the
+ * pcr_rows_kernel is used, and variant and native_divide do not apply.
+ * A single work-item per system (rows == sub_size == system_size)
+ * selects thomas_kernel.  A sub_size of zero selects the serial host solver.
+ *----------------------------------------------------------------------------*/
+
+struct tuning_t {
+	size_t sub_size;
+	bool native_divide;
+	pcr_variant_t variant;
+	double seconds;
+	size_t rows;
+
+	tuning_t()
+		: sub_size(0), native_divide(false), variant(pcr_branch_free),
+		seconds(0.0), rows(1)
+		{}
+}; // struct tuning_t
+
+/*----------------------------------------------------------------------------*
+ * Cost model for shapes without a tuning entry, in seconds.  A direct
+ * device solve costs device_latency + device_row*rows, a partitioned solve
+ * adds partition_latency and interface_row*rows for the host-side
+ * interface construction, and a host solve costs host_row*rows.
+ *----------------------------------------------------------------------------*/
+
+struct cost_model_t {
+	double host_row;
+	double interface_row;
+	double device_latency;
+	double device_row;
+	double partition_latency;
+
+	cost_model_t()
+		: host_row(0.0), interface_row(0.0), device_latency(0.0),
+		device_row(0.0), partition_latency(0.0)
+		{}
+}; // struct cost_model_t
+
+/*----------------------------------------------------------------------------*
+ * Persistent tuning database.
+ *
+ * Entries are keyed on (device, precision, system_size, num_systems) and
+ * stored one per line as whitespace-separated text.  The file is named by
+ * the TRICYCL_TUNING_FILE environment variable, or tricycl_tuning.dat in
+ * the current working directory.  All methods may be called concurrently.
+ *----------------------------------------------------------------------------*/
+
+class TuningDB
+{
+public:
+
+	/*-------------------------------------------------------------------------*
+	 * Database key.
+	 *-------------------------------------------------------------------------*/
+
+	struct key_t {
+		std::string device;
+		std::string precision;
+		size_t system_size;
+		size_t num_systems;
+
+		key_t(const std::string & _device, const std::string & _precision,
+			size_t _system_size, size_t _num_systems)
+			: device(_device), precision(_precision),
+			system_size(_system_size), num_systems(_num_systems) {}
+
+		bool operator < (const key_t & k) const {
+			if(device != k.device) return device < k.device;
+			if(precision != k.precision) return precision < k.precision;
+			if(system_size != k.system_size) return system_size < k.system_size;
+			return num_systems < k.num_systems;
+		} // operator <
+	}; // struct key_t
+
+	/*-------------------------------------------------------------------------*
+	 * Meyer's singleton instance method.
+	 *-------------------------------------------------------------------------*/
+
+	static TuningDB & instance() {
+		static TuningDB db;
+		return db;
+	} // instance
+
+	/*-------------------------------------------------------------------------*
+	 * Read the tuning file (only the first call does any work).
+	 *-------------------------------------------------------------------------*/
+
+	void load();
+
+	/*-------------------------------------------------------------------------*
+	 * Write all entries back to the tuning file.
+	 *-------------------------------------------------------------------------*/
+
+	void save();
+
+	/*-------------------------------------------------------------------------*
+	 * Lookup and insertion.
+	 *-------------------------------------------------------------------------*/
+
+	bool find(const key_t & key, tuning_t & tuning) const;
+	void insert(const key_t & key, const tuning_t & tuning);
+
+	std::string filename() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return filename_;
+	} // filename
+
+	/*-------------------------------------------------------------------------*
+	 * Device names may contain spaces, which the file format does not allow.
+	 *-------------------------------------------------------------------------*/
+
+	static std::string device_key(const char * name);
+
+private:
+
+	/*-------------------------------------------------------------------------*
+	 * Hide these.
+	 *-------------------------------------------------------------------------*/
+
+	TuningDB() : loaded_(false) {}
+	TuningDB(const TuningDB &) {}
+	TuningDB & operator = (const TuningDB &);
+
+	~TuningDB() {}
+
+	void load_locked();
+
+	/*-------------------------------------------------------------------------*
+	 * Private data members.
+	 *-------------------------------------------------------------------------*/
+
+	mutable std::mutex mutex_;
+	bool loaded_;
+	std::string filename_;
+	std::map<key_t, tuning_t> entries_;
+
+}; // class TuningDB
+
+#endif // tricycl_tuning_hh
@@ -103,6 +103,25 @@ const char * error_to_string(int err);
 #define CL_ABORTcreateKernel(err,name)			\
 	CL_ABORTkernel(clCreateKernel,err,name)
 
+/*------------------------------------------------------------------------------
+ * Non-fatal variants: report (verbose builds only) and return ret, so that
+ * the caller can fall back to another strategy.
+ *----------------------------------------------------------------------------*/
+
+#define CL_RETURNerr(call, err, ret) 											\
+	warning("OpenCL call " #call													\
+		" failed with %s(%d) in %s in file %s line %d\n",					\
+		error_to_string(err), (err), caller_function, caller_filename,	\
+		caller_linenumber);															\
+	return (ret);
+
+#define CL_RETURNkernel(call, err, name, ret)						\
+	warning("OpenCL kernel %s failed in " #call					\
+		" with %s(%d) in %s in file %s line %d\n",				\
+		(name), error_to_string(err), (err), caller_function,	\
+		caller_filename, caller_linenumber);						\
+	return (ret);
+
 #define CL_CHECKerr(call,...) {								\
 		cl_int err;													\
 		if((err = call(__VA_ARGS__)) != CL_SUCCESS) {	\
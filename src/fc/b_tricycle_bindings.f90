@@ -98,5 +98,33 @@ interface
       integer(c_int32_t) :: ierr
    end function tricycl_solve_dp_f90
 
+   !---------------------------------------------------------------------------!
+   ! tricycl_tune_sp_f90
+   !---------------------------------------------------------------------------!
+
+   function tricycl_tune_sp_f90(token, system_size, num_systems) &
+      result(ierr) bind(C, name="tricycl_tune_sp")
+      use, intrinsic :: ISO_C_BINDING
+      implicit none
+      integer(c_size_t), value :: token
+      integer(c_size_t), value :: system_size
+      integer(c_size_t), value :: num_systems
+      integer(c_int32_t) :: ierr
+   end function tricycl_tune_sp_f90
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_tune_dp_f90
+   !---------------------------------------------------------------------------!
+
+   function tricycl_tune_dp_f90(token, system_size, num_systems) &
+      result(ierr) bind(C, name="tricycl_tune_dp")
+      use, intrinsic :: ISO_C_BINDING
+      implicit none
+      integer(c_size_t), value :: token
+      integer(c_size_t), value :: system_size
+      integer(c_size_t), value :: num_systems
+      integer(c_int32_t) :: ierr
+   end function tricycl_tune_dp_f90
+
 end interface
 end module
@@ -109,4 +109,34 @@ module tricycl_interface
          a, b, c, d, x)
    end subroutine tricycl_solve_dp
 
+   !---------------------------------------------------------------------------!
+   ! tricycl_tune_sp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_tune_sp(token, system_size, num_systems, ierr)
+      use, intrinsic :: ISO_C_BINDING
+      implicit none
+      integer(c_size_t), value :: token
+      integer(c_size_t), value :: system_size
+      integer(c_size_t), value :: num_systems
+      integer(c_int32_t) :: ierr
+
+      ierr = tricycl_tune_sp_f90(token, system_size, num_systems)
+   end subroutine tricycl_tune_sp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_tune_dp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_tune_dp(token, system_size, num_systems, ierr)
+      use, intrinsic :: ISO_C_BINDING
+      implicit none
+      integer(c_size_t), value :: token
+      integer(c_size_t), value :: system_size
+      integer(c_size_t), value :: num_systems
+      integer(c_int32_t) :: ierr
+
+      ierr = tricycl_tune_dp_f90(token, system_size, num_systems)
+   end subroutine tricycl_tune_dp
+
 end module tricycl_interface
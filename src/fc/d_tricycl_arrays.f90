@@ -0,0 +1,235 @@
+!------------------------------------------------------------------------------!
+! Array interface.
+!
+! Solver handles take arrays shaped (system_size, num_systems).  The arrays
+! are declared contiguous, so their storage is passed to the library
+! directly.  A non-contiguous actual argument is still copied by the
+! compiler, so pass whole arrays or contiguous sections.  If x is omitted,
+! the solution is written to the x component of the handle, which is
+! allocated on the first such solve and reused after that.
+!------------------------------------------------------------------------------!
+
+module tricycl_arrays
+
+   use, intrinsic :: ISO_C_BINDING
+   use :: tricycl_bindings
+
+   implicit none
+
+   integer(c_int32_t), parameter :: TRICYCL_INVALID_VALUE = -1002
+
+   !---------------------------------------------------------------------------!
+   ! Solver handles
+   !---------------------------------------------------------------------------!
+
+   type :: tricycl_solver_sp
+      integer(c_size_t) :: token = 0
+      integer(c_size_t) :: system_size = 0
+      integer(c_size_t) :: num_systems = 0
+      real(c_float), allocatable :: x(:,:)
+   end type tricycl_solver_sp
+
+   type :: tricycl_solver_dp
+      integer(c_size_t) :: token = 0
+      integer(c_size_t) :: system_size = 0
+      integer(c_size_t) :: num_systems = 0
+      real(c_double), allocatable :: x(:,:)
+   end type tricycl_solver_dp
+
+   interface tricycl_solver_create
+      module procedure tricycl_solver_create_sp
+      module procedure tricycl_solver_create_dp
+   end interface tricycl_solver_create
+
+   interface tricycl_solver_solve
+      module procedure tricycl_solver_solve_sp
+      module procedure tricycl_solver_solve_dp
+   end interface tricycl_solver_solve
+
+   interface tricycl_solver_tune
+      module procedure tricycl_solver_tune_sp
+      module procedure tricycl_solver_tune_dp
+   end interface tricycl_solver_tune
+
+   interface tricycl_solver_destroy
+      module procedure tricycl_solver_destroy_sp
+      module procedure tricycl_solver_destroy_dp
+   end interface tricycl_solver_destroy
+
+   contains
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_create_sp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_create_sp(solver, token, system_size, &
+      num_systems)
+      type(tricycl_solver_sp), intent(inout) :: solver
+      integer(c_size_t), intent(in) :: token
+      integer(c_size_t), intent(in) :: system_size
+      integer(c_size_t), intent(in) :: num_systems
+
+      call tricycl_solver_destroy_sp(solver)
+
+      solver%token = token
+      solver%system_size = system_size
+      solver%num_systems = num_systems
+   end subroutine tricycl_solver_create_sp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_create_dp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_create_dp(solver, token, system_size, &
+      num_systems)
+      type(tricycl_solver_dp), intent(inout) :: solver
+      integer(c_size_t), intent(in) :: token
+      integer(c_size_t), intent(in) :: system_size
+      integer(c_size_t), intent(in) :: num_systems
+
+      call tricycl_solver_destroy_dp(solver)
+
+      solver%token = token
+      solver%system_size = system_size
+      solver%num_systems = num_systems
+   end subroutine tricycl_solver_create_dp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_solve_sp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_solve_sp(solver, a, b, c, d, ierr, x)
+      type(tricycl_solver_sp), target, intent(inout) :: solver
+      real(c_float), contiguous, target, intent(in) :: a(:,:)
+      real(c_float), contiguous, target, intent(in) :: b(:,:)
+      real(c_float), contiguous, target, intent(in) :: c(:,:)
+      real(c_float), contiguous, target, intent(in) :: d(:,:)
+      integer(c_int32_t), intent(out) :: ierr
+      real(c_float), contiguous, target, intent(out), optional :: x(:,:)
+      integer(c_size_t) :: dims(2)
+
+      dims = (/ solver%system_size, solver%num_systems /)
+
+      if(any(shape(a) /= dims) .or. any(shape(b) /= dims) .or. &
+         any(shape(c) /= dims) .or. any(shape(d) /= dims)) then
+         ierr = TRICYCL_INVALID_VALUE
+         return
+      end if
+
+      if(present(x)) then
+         if(any(shape(x) /= dims)) then
+            ierr = TRICYCL_INVALID_VALUE
+            return
+         end if
+
+         ierr = tricycl_solve_sp_f90(solver%token, solver%system_size, &
+            solver%num_systems, c_loc(a), c_loc(b), c_loc(c), c_loc(d), &
+            c_loc(x))
+      else
+         if(.not. allocated(solver%x)) then
+            allocate(solver%x(dims(1), dims(2)))
+         end if
+
+         ierr = tricycl_solve_sp_f90(solver%token, solver%system_size, &
+            solver%num_systems, c_loc(a), c_loc(b), c_loc(c), c_loc(d), &
+            c_loc(solver%x))
+      end if
+   end subroutine tricycl_solver_solve_sp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_solve_dp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_solve_dp(solver, a, b, c, d, ierr, x)
+      type(tricycl_solver_dp), target, intent(inout) :: solver
+      real(c_double), contiguous, target, intent(in) :: a(:,:)
+      real(c_double), contiguous, target, intent(in) :: b(:,:)
+      real(c_double), contiguous, target, intent(in) :: c(:,:)
+      real(c_double), contiguous, target, intent(in) :: d(:,:)
+      integer(c_int32_t), intent(out) :: ierr
+      real(c_double), contiguous, target, intent(out), optional :: x(:,:)
+      integer(c_size_t) :: dims(2)
+
+      dims = (/ solver%system_size, solver%num_systems /)
+
+      if(any(shape(a) /= dims) .or. any(shape(b) /= dims) .or. &
+         any(shape(c) /= dims) .or. any(shape(d) /= dims)) then
+         ierr = TRICYCL_INVALID_VALUE
+         return
+      end if
+
+      if(present(x)) then
+         if(any(shape(x) /= dims)) then
+            ierr = TRICYCL_INVALID_VALUE
+            return
+         end if
+
+         ierr = tricycl_solve_dp_f90(solver%token, solver%system_size, &
+            solver%num_systems, c_loc(a), c_loc(b), c_loc(c), c_loc(d), &
+            c_loc(x))
+      else
+         if(.not. allocated(solver%x)) then
+            allocate(solver%x(dims(1), dims(2)))
+         end if
+
+         ierr = tricycl_solve_dp_f90(solver%token, solver%system_size, &
+            solver%num_systems, c_loc(a), c_loc(b), c_loc(c), c_loc(d), &
+            c_loc(solver%x))
+      end if
+   end subroutine tricycl_solver_solve_dp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_tune_sp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_tune_sp(solver, ierr)
+      type(tricycl_solver_sp), intent(in) :: solver
+      integer(c_int32_t), intent(out) :: ierr
+
+      ierr = tricycl_tune_sp_f90(solver%token, solver%system_size, &
+         solver%num_systems)
+   end subroutine tricycl_solver_tune_sp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_tune_dp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_tune_dp(solver, ierr)
+      type(tricycl_solver_dp), intent(in) :: solver
+      integer(c_int32_t), intent(out) :: ierr
+
+      ierr = tricycl_tune_dp_f90(solver%token, solver%system_size, &
+         solver%num_systems)
+   end subroutine tricycl_solver_tune_dp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_destroy_sp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_destroy_sp(solver)
+      type(tricycl_solver_sp), intent(inout) :: solver
+
+      if(allocated(solver%x)) then
+         deallocate(solver%x)
+      end if
+
+      solver%system_size = 0
+      solver%num_systems = 0
+   end subroutine tricycl_solver_destroy_sp
+
+   !---------------------------------------------------------------------------!
+   ! tricycl_solver_destroy_dp
+   !---------------------------------------------------------------------------!
+
+   subroutine tricycl_solver_destroy_dp(solver)
+      type(tricycl_solver_dp), intent(inout) :: solver
+
+      if(allocated(solver%x)) then
+         deallocate(solver%x)
+      end if
+
+      solver%system_size = 0
+      solver%num_systems = 0
+   end subroutine tricycl_solver_destroy_dp
+
+end module tricycl_arrays
@@ -7,4 +7,5 @@ module tricycl
    use, intrinsic :: ISO_C_BINDING
    use :: tricycl_bindings
    use :: tricycl_interface
+   use :: tricycl_arrays
 end module tricycl